@@ -0,0 +1,462 @@
+//
+//  AMDMicrophoneACP.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneACP_hpp
+#define AMDMicrophoneACP_hpp
+
+#include "AMDMicrophoneChips.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#define ACP_ERROR_MASK                        0x20000000
+#define ACP_EXT_INTR_STAT_CLEAR_MASK          0xFFFFFFFF
+#define ACP_PDM_CLK_FREQ_MASK                 0x7
+#define ACP_PDM_DMA_INTR_MASK                 0x10000
+#define ACP_PGFSM_CNTL_POWER_OFF_MASK         0x0
+#define ACP_PGFSM_CNTL_POWER_ON_MASK          0x1
+#define ACP_PGFSM_STATUS_MASK                 0x3
+#define ACP_SOFT_RESET_SOFTRESET_AUDDONE_MASK 0x10001
+#define ACP_WOV_GAIN_CONTROL                  0x18
+#define ACP_WOV_GAIN_CONTROL_SHIFT            0x3
+#define ACP_WOV_PDM_GAIN                      0x2
+
+#define ACP_COUNTER               20000
+#define ACP_SPIN_POLLS            32
+#define ACP_MAX_POLL_DELAY        64
+#define ACP_DMA_PAGE_SIZE         4096
+#define ACP_MEM_WINDOW_START      0x4000000
+#define ACP_PAGE_SIZE_4K_ENABLE   0x2
+#define ACP_PDM_DECIMATION_FACTOR 0x2
+#define ACP_PDM_CHANNELS_2        0x0
+#define ACP_PDM_CHANNELS_4        0x1
+#define ACP_PDM_DMA_EN_STATUS     0x2
+#define ACP_POWER_ON_IN_PROGRESS  0x1
+#define ACP_POWERED_OFF           0x2
+
+#define BIT(n) (1UL << (n))
+
+// A physically contiguous run of DMA pages.
+struct AMDMicrophoneDMARun {
+    UInt64 address;
+    UInt32 pages;
+};
+
+// Register-level programming of the ACP PDM block. The register accesses and
+// delays go through Bus, which provides readl(reg), writel(val, reg),
+// delay(us) and relax(). The kext plugs in the BAR0 mapping; a host build can
+// plug in a software model of the block instead. Map gives the register
+// offsets of the ACP generation, see AMDMicrophoneChips.hpp.
+template <typename Bus, typename Map = AMDMicrophoneRenoir>
+class AMDMicrophoneACP {
+    static_assert(isValidRegisterMap<Map>(), "invalid ACP register map");
+
+public:
+    Bus bus;
+    UInt64 dmaStartByteCount = 0;
+    UInt64 lastPeriodCount = 0;
+    UInt64 lastByteCount = 0;
+    UInt64 counterRegressions = 0;
+    UInt32 lastPollCount = 0;
+    UInt32 lastPollMicroseconds = 0;
+
+    UInt32 readl(UInt32 reg) { return bus.readl(reg); }
+    void writel(UInt32 val, UInt32 reg) { bus.writel(val, reg); }
+
+    // Register sequences of the driver's entry points, see
+    // AMDMicrophoneDevice. The register trace replays them the same way.
+    IOReturn powerUp(const AMDMicrophoneDMARun* runs, UInt32 runCount);
+    IOReturn powerDown();
+    IOReturn startCapture(UInt32 bufferSize, UInt32 watermarkSize, UInt32 channels);
+    IOReturn stopCapture();
+
+    bool acknowledgeInterrupt();
+    void configATU();
+    void configPDM(UInt32 channels);
+    IOReturn deinit();
+    void disableInterrupt();
+    void enableClock();
+    void enableInterrupt();
+    UInt64 getByteCount();
+    UInt64 getRelativeByteCount();
+    IOReturn init();
+    void initRingBuffer(UInt32 physAddr, UInt32 bufferSize, UInt32 watermarkSize);
+    IOReturn powerOff();
+    IOReturn powerOn();
+    IOReturn reset();
+    IOReturn startDMA();
+    IOReturn stopDMA();
+    bool verifyPTEs(UInt32 firstPage, UInt64 address, UInt32 count);
+    IOReturn waitForRegister(UInt32 reg, UInt32 mask, UInt32 value);
+    void writePTEs(UInt32 firstPage, UInt64 address, UInt32 count);
+};
+
+// Powers the block on, brings it out of reset and points the ATU at the
+// DMA ring. All PTEs are posted before any is read back.
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::powerUp(const AMDMicrophoneDMARun* runs, UInt32 runCount)
+{
+    IOReturn ret;
+    UInt32 page;
+
+    ret = powerOn();
+    if (ret != kIOReturnSuccess)
+        return ret;
+
+    ret = init();
+    if (ret != kIOReturnSuccess)
+        return ret;
+
+    configATU();
+
+    page = 0;
+    for (UInt32 run = 0; run < runCount; run++) {
+        writePTEs(page, runs[run].address, runs[run].pages);
+        page += runs[run].pages;
+    }
+
+    page = 0;
+    for (UInt32 run = 0; run < runCount; run++) {
+        if (!verifyPTEs(page, runs[run].address, runs[run].pages))
+            return kIOReturnIOError;
+        page += runs[run].pages;
+    }
+
+    return kIOReturnSuccess;
+}
+
+// The block is powered off even if the reset times out.
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::powerDown()
+{
+    IOReturn ret = deinit();
+    IOReturn off = powerOff();
+
+    return ret != kIOReturnSuccess ? ret : off;
+}
+
+// channels is 2 or 4. The ring starts at the bottom of the DMA window.
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::startCapture(UInt32 bufferSize, UInt32 watermarkSize, UInt32 channels)
+{
+    IOReturn ret;
+
+    initRingBuffer(ACP_MEM_WINDOW_START, bufferSize, watermarkSize);
+    configPDM(channels == 4 ? ACP_PDM_CHANNELS_4 : ACP_PDM_CHANNELS_2);
+
+    ret = startDMA();
+    if (ret != kIOReturnSuccess)
+        return ret;
+
+    enableInterrupt();
+    return kIOReturnSuccess;
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::stopCapture()
+{
+    disableInterrupt();
+    return stopDMA();
+}
+
+template <typename Bus, typename Map>
+bool AMDMicrophoneACP<Bus, Map>::acknowledgeInterrupt()
+{
+    UInt32 val;
+
+    val = readl(Map::externalIntrStat);
+    if (!(val & BIT(Map::pdmDmaStat)))
+        return false;
+
+    writel(BIT(Map::pdmDmaStat), Map::externalIntrStat);
+    return true;
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::configATU()
+{
+    writel(Map::sramPteOffset | BIT(31), Map::atuBaseAddrGrp1);
+    writel(ACP_PAGE_SIZE_4K_ENABLE, Map::atuPageSizeGrp1);
+}
+
+// channels is ACP_PDM_CHANNELS_2 or ACP_PDM_CHANNELS_4.
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::configPDM(UInt32 channels)
+{
+    writel(channels, Map::wovPdmChannels);
+    writel(ACP_PDM_DECIMATION_FACTOR, Map::wovPdmDecimation);
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::deinit()
+{
+    IOReturn ret = reset();
+
+    writel(0x0, Map::clkmuxSel);
+    writel(0x0, Map::control);
+
+    return ret;
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::disableInterrupt()
+{
+    writel(ACP_EXT_INTR_STAT_CLEAR_MASK, Map::externalIntrStat);
+    writel(0x0, Map::externalIntrEnb);
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::enableClock()
+{
+    UInt32 val;
+
+    writel(ACP_PDM_CLK_FREQ_MASK, Map::wovClkCtrl);
+    val = readl(Map::wovMiscCtrl);
+    val &= ~ACP_WOV_GAIN_CONTROL;
+    val |= (ACP_WOV_PDM_GAIN << ACP_WOV_GAIN_CONTROL_SHIFT) & ACP_WOV_GAIN_CONTROL;
+    writel(val, Map::wovMiscCtrl);
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::enableInterrupt()
+{
+    writel(0x1, Map::externalIntrEnb);
+    writel(ACP_PDM_DMA_INTR_MASK, Map::externalIntrCntl);
+}
+
+template <typename Bus, typename Map>
+UInt64 AMDMicrophoneACP<Bus, Map>::getByteCount()
+{
+    UInt32 low, high, check;
+
+    // The halves are separate registers; re-read if the low word carried
+    // into the high word in between.
+    high = readl(Map::wovRxPositionHigh);
+    low = readl(Map::wovRxPositionLow);
+    check = readl(Map::wovRxPositionHigh);
+    if (check != high) {
+        high = check;
+        low = readl(Map::wovRxPositionLow);
+    }
+
+    return ((UInt64)high << 32) | low;
+}
+
+// The counter only moves forward while DMA runs. A read below the previous
+// one, or below the start value, is counted as a regression; the latter
+// still reads as 0.
+template <typename Bus, typename Map>
+UInt64 AMDMicrophoneACP<Bus, Map>::getRelativeByteCount()
+{
+    UInt64 byteCount = getByteCount();
+    UInt64 previous = __atomic_exchange_n(&lastByteCount, byteCount, __ATOMIC_RELAXED);
+
+    if (byteCount < previous || byteCount < dmaStartByteCount)
+        __atomic_fetch_add(&counterRegressions, 1, __ATOMIC_RELAXED);
+
+    if (byteCount < dmaStartByteCount)
+        return 0;
+
+    return byteCount - dmaStartByteCount;
+}
+
+// Brings a powered block out of reset with the clock mux on; the PTEs have
+// to be written again afterwards.
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::init()
+{
+    IOReturn ret;
+
+    writel(0x1, Map::control);
+    ret = reset();
+    if (ret != kIOReturnSuccess)
+        return ret;
+
+    writel(0x3, Map::clkmuxSel);
+    return kIOReturnSuccess;
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::initRingBuffer(UInt32 physAddr, UInt32 bufferSize, UInt32 watermarkSize)
+{
+    writel(physAddr, Map::wovRxRingbufAddr);
+    writel(bufferSize, Map::wovRxRingbufSize);
+    writel(watermarkSize, Map::wovRxWatermarkSize);
+    writel(0x1, Map::atuCtrl);
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::powerOff()
+{
+    UInt32 val;
+    UInt32 timeout;
+
+    writel(ACP_PGFSM_CNTL_POWER_OFF_MASK, Map::pgfsmControl);
+
+    timeout = 0;
+    while (++timeout < 500) {
+        val = readl(Map::pgfsmStatus);
+        if ((val & ACP_PGFSM_STATUS_MASK) == ACP_POWERED_OFF)
+            return kIOReturnSuccess;
+        bus.delay(1);
+    }
+
+    return kIOReturnTimeout;
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::powerOn()
+{
+    UInt32 val;
+    UInt32 timeout;
+
+    val = readl(Map::pgfsmStatus);
+    if (val == 0)
+        return val;
+
+    if ((val & ACP_PGFSM_STATUS_MASK) != ACP_POWER_ON_IN_PROGRESS)
+        writel(ACP_PGFSM_CNTL_POWER_ON_MASK, Map::pgfsmControl);
+
+    timeout = 0;
+    while (++timeout < 500) {
+        val = readl(Map::pgfsmStatus);
+        if (!val)
+            return kIOReturnSuccess;
+        bus.delay(1);
+    }
+
+    return kIOReturnTimeout;
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::reset()
+{
+    UInt32 val;
+    UInt32 timeout;
+
+    writel(0x1, Map::softReset);
+    timeout = 0;
+    while (++timeout < 500) {
+        val = readl(Map::softReset);
+        if (val & ACP_SOFT_RESET_SOFTRESET_AUDDONE_MASK)
+            break;
+        bus.relax();
+    }
+    writel(0x0, Map::softReset);
+    timeout = 0;
+    while (++timeout < 500) {
+        val = readl(Map::softReset);
+        if (!val)
+            return kIOReturnSuccess;
+        bus.relax();
+    }
+    return kIOReturnTimeout;
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::startDMA()
+{
+    writel(0x1, Map::wovPdmFifoFlush);
+    enableClock();
+    writel(0x1, Map::wovPdmEnable);
+    writel(0x1, Map::wovPdmDmaEnable);
+
+    if (waitForRegister(Map::wovPdmDmaEnable, 0x2, ACP_PDM_DMA_EN_STATUS) != kIOReturnSuccess)
+        return kIOReturnTimeout;
+
+    dmaStartByteCount = getByteCount();
+    lastByteCount = dmaStartByteCount;
+    lastPeriodCount = 0;
+    return kIOReturnSuccess;
+}
+
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::stopDMA()
+{
+    UInt32 val;
+
+    val = readl(Map::wovPdmDmaEnable);
+    if (val & 0x1) {
+        writel(0x0, Map::wovPdmDmaEnable);
+        if (waitForRegister(Map::wovPdmDmaEnable, 0xFFFFFFFF, 0x0) != kIOReturnSuccess)
+            return kIOReturnTimeout;
+    }
+
+    val = readl(Map::wovPdmEnable);
+    if (val == 0x1)
+        writel(0x0, Map::wovPdmEnable);
+
+    writel(0x1, Map::wovPdmFifoFlush);
+
+    return kIOReturnSuccess;
+}
+
+// Polls until (reg & mask) == value. The DMA status usually latches within a
+// few register reads, so spin first and only then back off with doubling
+// delays. The time budget is the same ACP_COUNTER * 5 us as a fixed 5 us
+// poll. The poll count and time spent sleeping are kept for diagnostics.
+template <typename Bus, typename Map>
+IOReturn AMDMicrophoneACP<Bus, Map>::waitForRegister(UInt32 reg, UInt32 mask, UInt32 value)
+{
+    UInt32 polls = 0;
+    UInt32 waited = 0;
+    UInt32 delay = 1;
+    IOReturn result = kIOReturnSuccess;
+
+    while ((readl(reg) & mask) != value) {
+        if (++polls < ACP_SPIN_POLLS) {
+            bus.relax();
+            continue;
+        }
+        if (waited >= ACP_COUNTER * 5) {
+            result = kIOReturnTimeout;
+            break;
+        }
+        bus.delay(delay);
+        waited += delay;
+        if (delay < ACP_MAX_POLL_DELAY)
+            delay *= 2;
+    }
+
+    lastPollCount = polls + 1;
+    lastPollMicroseconds = waited;
+
+    return result;
+}
+
+// Each PTE is a low and a high word, the high word carrying the valid bit.
+// A physically contiguous run of pages is written in one go: the writes are
+// posted back to back, and verifyPTEs() reads them all back afterwards.
+template <typename Bus, typename Map>
+void AMDMicrophoneACP<Bus, Map>::writePTEs(UInt32 firstPage, UInt64 address, UInt32 count)
+{
+    for (UInt32 page = firstPage; page < firstPage + count; page++) {
+        writel((UInt32)address, Map::scratchReg0 + page * 8);
+        writel((UInt32)(address >> 32) | BIT(31), Map::scratchReg0 + page * 8 + 4);
+        address += ACP_DMA_PAGE_SIZE;
+    }
+}
+
+// True for the PTE words in the scratch SRAM.
+template <typename Map>
+constexpr bool isPTERegister(UInt32 reg)
+{
+    return reg >= Map::scratchReg0 && reg < Map::scratchReg0 + ACP_PTE_WINDOW;
+}
+
+template <typename Bus, typename Map>
+bool AMDMicrophoneACP<Bus, Map>::verifyPTEs(UInt32 firstPage, UInt64 address, UInt32 count)
+{
+    for (UInt32 page = firstPage; page < firstPage + count; page++) {
+        if (readl(Map::scratchReg0 + page * 8) != (UInt32)address
+            || readl(Map::scratchReg0 + page * 8 + 4) != ((UInt32)(address >> 32) | BIT(31)))
+            return false;
+        address += ACP_DMA_PAGE_SIZE;
+    }
+
+    return true;
+}
+
+#endif /* AMDMicrophoneACP_hpp */
@@ -0,0 +1,126 @@
+//
+//  AMDMicrophoneChip.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneChip_hpp
+#define AMDMicrophoneChip_hpp
+
+#include "AMDMicrophoneACP.hpp"
+#include "AMDMicrophoneShadow.hpp"
+#include "AMDMicrophoneTrace.hpp"
+
+#include <IOKit/IOLib.h>
+
+#define cpu_relax() asm volatile("rep; nop")
+
+// Direct access to the ACP registers through the BAR0 mapping, which starts
+// at the map's base.
+template <typename Map>
+struct AMDMicrophoneMMIO {
+    IOVirtualAddress baseAddr;
+
+    UInt32 readl(UInt32 reg)
+    {
+        return *(const volatile UInt32*)(baseAddr + reg - Map::base);
+    }
+
+    void writel(UInt32 val, UInt32 reg)
+    {
+        *(volatile UInt32*)(baseAddr + reg - Map::base) = val;
+    }
+
+    void delay(UInt32 us) { IODelay(us); }
+    void relax() { cpu_relax(); }
+};
+
+// Register path of the kext for one ACP generation: the shadow drops
+// redundant accesses before the trace records what reaches the hardware.
+template <typename Map>
+using AMDMicrophoneChipACP
+    = AMDMicrophoneACP<AMDMicrophoneShadow<AMDMicrophoneTraceBus<AMDMicrophoneMMIO<Map>, Map>, Map>, Map>;
+
+// Register maps the kext drives. The device and the engine instantiate their
+// hot paths once for every map listed here, and probe() binds the map whose
+// revisions contain the ACP's PCI revision.
+#define ACP_SUPPORTED_MAPS(MAP) \
+    MAP(AMDMicrophoneRenoir)    \
+    MAP(AMDMicrophoneYellowCarp)
+
+// Counters the register path keeps, for the registry.
+struct AMDMicrophoneChipStatus {
+    UInt64 counterRegressions;
+    UInt32 lastPollCount;
+    UInt32 lastPollMicroseconds;
+    AMDMicrophoneMMIOCounts counts;
+};
+
+// Entry points of the register path that run on the work loop: power, start
+// and stop. The chip is an AMDMicrophoneChipACP of the bound map; the hot
+// paths cast it back with AMDMicrophoneChipFor<Map>::from() and call it
+// directly.
+struct AMDMicrophoneChipOps {
+    const char* name;
+    UInt32 barSize;
+    bool (*matches)(UInt8 revision);
+    void* (*create)(IOVirtualAddress baseAddr);
+    void (*destroy)(void* chip);
+    void (*setTrace)(void* chip, AMDMicrophoneTrace* trace);
+    IOReturn (*powerUp)(void* chip, const AMDMicrophoneDMARun* runs, UInt32 runCount);
+    IOReturn (*powerDown)(void* chip);
+    IOReturn (*startCapture)(void* chip, UInt32 bufferSize, UInt32 watermarkSize, UInt32 channels);
+    IOReturn (*stopCapture)(void* chip);
+    UInt64 (*getRelativeByteCount)(void* chip);
+    AMDMicrophoneChipStatus (*status)(const void* chip);
+};
+
+template <typename Map>
+struct AMDMicrophoneChipFor {
+    typedef AMDMicrophoneChipACP<Map> ACP;
+
+    static ACP* from(void* chip) { return (ACP*)chip; }
+    static const ACP* from(const void* chip) { return (const ACP*)chip; }
+
+    static void* create(IOVirtualAddress baseAddr)
+    {
+        ACP* acp = new ACP;
+
+        if (acp)
+            acp->bus.baseAddr = baseAddr;
+        return acp;
+    }
+
+    static void destroy(void* chip) { delete from(chip); }
+    static void setTrace(void* chip, AMDMicrophoneTrace* trace) { from(chip)->bus.trace = trace; }
+
+    static IOReturn powerUp(void* chip, const AMDMicrophoneDMARun* runs, UInt32 runCount)
+    {
+        return from(chip)->powerUp(runs, runCount);
+    }
+
+    static IOReturn powerDown(void* chip) { return from(chip)->powerDown(); }
+
+    static IOReturn startCapture(void* chip, UInt32 bufferSize, UInt32 watermarkSize, UInt32 channels)
+    {
+        return from(chip)->startCapture(bufferSize, watermarkSize, channels);
+    }
+
+    static IOReturn stopCapture(void* chip) { return from(chip)->stopCapture(); }
+    static UInt64 getRelativeByteCount(void* chip) { return from(chip)->getRelativeByteCount(); }
+
+    static AMDMicrophoneChipStatus status(const void* chip)
+    {
+        const ACP* acp = from(chip);
+
+        return { acp->counterRegressions, acp->lastPollCount, acp->lastPollMicroseconds, acp->bus.counts };
+    }
+
+    static constexpr AMDMicrophoneChipOps ops = {
+        Map::name, Map::size, matchesRevision<Map>, create, destroy, setTrace, powerUp, powerDown,
+        startCapture, stopCapture, getRelativeByteCount, status,
+    };
+};
+
+#endif /* AMDMicrophoneChip_hpp */
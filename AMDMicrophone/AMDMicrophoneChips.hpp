@@ -0,0 +1,162 @@
+//
+//  AMDMicrophoneChips.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneChips_hpp
+#define AMDMicrophoneChips_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+// Bytes of PTEs the driver may write from scratchReg0, 8 per page.
+#define ACP_PTE_WINDOW 0x200
+
+// Renoir (ACP 3.x) register offsets.
+#define ACP_PHY_BASE_ADDRESS               0x1240000
+#define ACP_REG_END                        0x1250200
+#define ACP_AXI2AXI_ATU_PAGE_SIZE_GRP_1    0x1240C00
+#define ACP_AXI2AXI_ATU_BASE_ADDR_GRP_1    0x1240C04
+#define ACP_AXI2AXI_ATU_CTRL               0x1240C40
+#define ACP_SOFT_RESET                     0x1241000
+#define ACP_CONTROL                        0x1241004
+#define ACP_EXTERNAL_INTR_ENB              0x1241800
+#define ACP_EXTERNAL_INTR_CNTL             0x1241804
+#define ACP_EXTERNAL_INTR_STAT             0x1241808
+#define ACP_PGFSM_CONTROL                  0x124141C
+#define ACP_PGFSM_STATUS                   0x1241420
+#define ACP_CLKMUX_SEL                     0x1241424
+#define ACP_WOV_PDM_ENABLE                 0x1242C04
+#define ACP_WOV_PDM_DMA_ENABLE             0x1242C08
+#define ACP_WOV_RX_RINGBUFADDR             0x1242C0C
+#define ACP_WOV_RX_RINGBUFSIZE             0x1242C10
+#define ACP_WOV_RX_LINEARPOSITIONCNTR_HIGH 0x1242C18
+#define ACP_WOV_RX_LINEARPOSITIONCNTR_LOW  0x1242C1C
+#define ACP_WOV_RX_INTR_WATERMARK_SIZE     0x1242C20
+#define ACP_WOV_PDM_FIFO_FLUSH             0x1242C24
+#define ACP_WOV_PDM_NO_OF_CHANNELS         0x1242C28
+#define ACP_WOV_PDM_DECIMATION_FACTOR      0x1242C2C
+#define ACP_WOV_MISC_CTRL                  0x1242C5C
+#define ACP_WOV_CLK_CTRL                   0x1242C60
+#define ACP_SCRATCH_REG_0                  0x1250000
+#define ACP_SRAM_PTE_OFFSET                0x2050000
+#define ACP_PDM_DMA_STAT                   0x10
+
+// Register map of one ACP generation, the Map parameter of AMDMicrophoneACP
+// and AMDMicrophoneShadow. Every offset is a compile-time constant, so each
+// generation gets its own instantiation of the register code and the hot
+// paths carry no lookups.
+struct AMDMicrophoneRenoir {
+    static constexpr UInt8 revisions[] = { 0x01 };
+    static constexpr const char* name = "Renoir";
+    static constexpr UInt32 base = ACP_PHY_BASE_ADDRESS;
+    static constexpr UInt32 size = ACP_REG_END - ACP_PHY_BASE_ADDRESS;
+
+    static constexpr UInt32 atuPageSizeGrp1 = ACP_AXI2AXI_ATU_PAGE_SIZE_GRP_1;
+    static constexpr UInt32 atuBaseAddrGrp1 = ACP_AXI2AXI_ATU_BASE_ADDR_GRP_1;
+    static constexpr UInt32 atuCtrl = ACP_AXI2AXI_ATU_CTRL;
+    static constexpr UInt32 softReset = ACP_SOFT_RESET;
+    static constexpr UInt32 control = ACP_CONTROL;
+    static constexpr UInt32 externalIntrEnb = ACP_EXTERNAL_INTR_ENB;
+    static constexpr UInt32 externalIntrCntl = ACP_EXTERNAL_INTR_CNTL;
+    static constexpr UInt32 externalIntrStat = ACP_EXTERNAL_INTR_STAT;
+    static constexpr UInt32 pgfsmControl = ACP_PGFSM_CONTROL;
+    static constexpr UInt32 pgfsmStatus = ACP_PGFSM_STATUS;
+    static constexpr UInt32 clkmuxSel = ACP_CLKMUX_SEL;
+    static constexpr UInt32 wovPdmEnable = ACP_WOV_PDM_ENABLE;
+    static constexpr UInt32 wovPdmDmaEnable = ACP_WOV_PDM_DMA_ENABLE;
+    static constexpr UInt32 wovRxRingbufAddr = ACP_WOV_RX_RINGBUFADDR;
+    static constexpr UInt32 wovRxRingbufSize = ACP_WOV_RX_RINGBUFSIZE;
+    static constexpr UInt32 wovRxPositionHigh = ACP_WOV_RX_LINEARPOSITIONCNTR_HIGH;
+    static constexpr UInt32 wovRxPositionLow = ACP_WOV_RX_LINEARPOSITIONCNTR_LOW;
+    static constexpr UInt32 wovRxWatermarkSize = ACP_WOV_RX_INTR_WATERMARK_SIZE;
+    static constexpr UInt32 wovPdmFifoFlush = ACP_WOV_PDM_FIFO_FLUSH;
+    static constexpr UInt32 wovPdmChannels = ACP_WOV_PDM_NO_OF_CHANNELS;
+    static constexpr UInt32 wovPdmDecimation = ACP_WOV_PDM_DECIMATION_FACTOR;
+    static constexpr UInt32 wovMiscCtrl = ACP_WOV_MISC_CTRL;
+    static constexpr UInt32 wovClkCtrl = ACP_WOV_CLK_CTRL;
+    static constexpr UInt32 scratchReg0 = ACP_SCRATCH_REG_0;
+    static constexpr UInt32 sramPteOffset = ACP_SRAM_PTE_OFFSET;
+    static constexpr UInt32 pdmDmaStat = ACP_PDM_DMA_STAT;
+};
+
+// Yellow Carp (ACP 6.x) register offsets, after the Linux acp6x driver. The
+// clock, power and interrupt registers moved; the WOV block did not. Not yet
+// tested on hardware.
+#define ACP6X_PHY_BASE_ADDRESS     0x1240000
+#define ACP6X_REG_END              0x1250200
+#define ACP6X_PGFSM_CONTROL        0x1241024
+#define ACP6X_PGFSM_STATUS         0x1241028
+#define ACP6X_CLKMUX_SEL           0x124102C
+#define ACP6X_EXTERNAL_INTR_ENB    0x1241A00
+#define ACP6X_EXTERNAL_INTR_CNTL   0x1241A04
+#define ACP6X_EXTERNAL_INTR_STAT   0x1241A0C
+#define ACP6X_SRAM_PTE_OFFSET      0x3800000
+
+struct AMDMicrophoneYellowCarp : AMDMicrophoneRenoir {
+    static constexpr UInt8 revisions[] = { 0x60, 0x6f };
+    static constexpr const char* name = "Yellow Carp";
+    static constexpr UInt32 base = ACP6X_PHY_BASE_ADDRESS;
+    static constexpr UInt32 size = ACP6X_REG_END - ACP6X_PHY_BASE_ADDRESS;
+
+    static constexpr UInt32 externalIntrEnb = ACP6X_EXTERNAL_INTR_ENB;
+    static constexpr UInt32 externalIntrCntl = ACP6X_EXTERNAL_INTR_CNTL;
+    static constexpr UInt32 externalIntrStat = ACP6X_EXTERNAL_INTR_STAT;
+    static constexpr UInt32 pgfsmControl = ACP6X_PGFSM_CONTROL;
+    static constexpr UInt32 pgfsmStatus = ACP6X_PGFSM_STATUS;
+    static constexpr UInt32 clkmuxSel = ACP6X_CLKMUX_SEL;
+    static constexpr UInt32 sramPteOffset = ACP6X_SRAM_PTE_OFFSET;
+};
+
+// Checked when a map is instantiated: every register lies in the map's own
+// BAR0 window from base to base + size, is word aligned and has an address
+// of its own, and the PTEs fit in the window too.
+template <typename Map>
+constexpr bool isValidRegisterMap()
+{
+    const UInt32 registers[] = {
+        Map::atuPageSizeGrp1, Map::atuBaseAddrGrp1, Map::atuCtrl, Map::softReset, Map::control,
+        Map::externalIntrEnb, Map::externalIntrCntl, Map::externalIntrStat, Map::pgfsmControl, Map::pgfsmStatus,
+        Map::clkmuxSel, Map::wovPdmEnable, Map::wovPdmDmaEnable, Map::wovRxRingbufAddr, Map::wovRxRingbufSize,
+        Map::wovRxPositionHigh, Map::wovRxPositionLow, Map::wovRxWatermarkSize, Map::wovPdmFifoFlush,
+        Map::wovPdmChannels, Map::wovPdmDecimation, Map::wovMiscCtrl, Map::wovClkCtrl, Map::scratchReg0,
+    };
+    const UInt32 count = sizeof(registers) / sizeof(registers[0]);
+
+    for (UInt32 index = 0; index < count; index++) {
+        if (registers[index] < Map::base || registers[index] >= Map::base + Map::size || (registers[index] & 3))
+            return false;
+        for (UInt32 other = 0; other < index; other++) {
+            if (registers[other] == registers[index])
+                return false;
+        }
+    }
+
+    return Map::scratchReg0 + ACP_PTE_WINDOW <= Map::base + Map::size && Map::pdmDmaStat < 32;
+}
+
+// PCI revisions the map drives, from its revisions list.
+template <typename Map>
+constexpr bool matchesRevision(UInt8 revision)
+{
+    for (UInt8 candidate : Map::revisions) {
+        if (candidate == revision)
+            return true;
+    }
+
+    return false;
+}
+
+// ACP generations without a register map, so probe() can name them. Raven
+// and Van Gogh route their microphones through I2S codecs and have no PDM
+// block to map.
+static const struct {
+    UInt8 revision;
+    const char* name;
+} unsupportedGenerations[] = {
+    { 0x00, "Raven" },
+    { 0x50, "Van Gogh" },
+};
+
+#endif /* AMDMicrophoneChips_hpp */
@@ -0,0 +1,179 @@
+//
+//  AMDMicrophoneClock.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneClock_hpp
+#define AMDMicrophoneClock_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+#define CLOCK_BANDWIDTH_HZ  0.5
+#define CLOCK_LOCK_UPDATES  8
+#define CLOCK_STALE_PERIODS 3
+
+// Delay-locked loop that tracks the DMA position against host time. Each
+// watermark interrupt feeds one (host time, hardware frame) measurement; the
+// loop filters it into a position at an anchor time plus a rate, so positions
+// and wrap times can be answered without reading the counter again.
+//
+// update() runs on one thread at a time. predict() may run concurrently on
+// any thread and reads the model through a sequence counter.
+class AMDMicrophoneClock {
+    UInt32 sequence = 0;
+    UInt64 anchorTime = 0;
+    double anchorFrame = 0.0;
+    double rate = 0.0;
+    UInt32 updates = 0;
+
+    double nominalRate = 0.0;
+    double phaseGain = 0.0;
+    double rateGain = 0.0;
+    UInt64 periodFrames = 0;
+    UInt64 periodTicks = 0;
+    UInt64 staleTicks = 0;
+
+public:
+    UInt64 relocks = 0;
+
+    void configure(UInt64 ticksPerSecond, UInt32 sampleRate, UInt32 framesPerPeriod);
+    void reset();
+    void update(UInt64 time, UInt64 frame);
+    bool predict(UInt64 time, UInt64* frame) const;
+    UInt64 timeAt(UInt64 frame) const;
+    bool predictTime(UInt64 frame, UInt64* time) const;
+    double getRate() const { return rate; }
+};
+
+inline void AMDMicrophoneClock::configure(UInt64 ticksPerSecond, UInt32 sampleRate, UInt32 framesPerPeriod)
+{
+    // Second-order loop, critically damped, with the bandwidth expressed per
+    // update: w = 2 pi B T, phase gain sqrt(2) w, rate gain w^2.
+    double omega = 2.0 * 3.14159265358979323846 * CLOCK_BANDWIDTH_HZ * framesPerPeriod / sampleRate;
+
+    nominalRate = (double)sampleRate / ticksPerSecond;
+    phaseGain = 1.41421356237309504880 * omega;
+    rateGain = omega * omega;
+    periodFrames = framesPerPeriod;
+    periodTicks = (UInt64)(framesPerPeriod / nominalRate);
+    staleTicks = CLOCK_STALE_PERIODS * periodTicks;
+    reset();
+}
+
+inline void AMDMicrophoneClock::reset()
+{
+    __atomic_store_n(&updates, 0, __ATOMIC_RELEASE);
+}
+
+inline void AMDMicrophoneClock::update(UInt64 time, UInt64 frame)
+{
+    UInt64 elapsed = time - anchorTime;
+    double predicted, error;
+
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    predicted = anchorFrame + rate * elapsed;
+    error = (double)frame - predicted;
+
+    if (updates == 0 || elapsed == 0 || error > periodFrames / 2 || error < -(double)(periodFrames / 2)) {
+        // First measurement, or the model lost track (stalled interrupts,
+        // counter reset): start over from this measurement.
+        if (updates != 0)
+            relocks++;
+        anchorFrame = (double)frame;
+        rate = nominalRate;
+        updates = 1;
+    } else {
+        anchorFrame = predicted + phaseGain * error;
+        // An interrupt that follows a late one closely measures the same
+        // counter quantization over a much shorter time; dividing by less
+        // than a period would turn that into a large rate step.
+        rate += rateGain * error / (elapsed > periodTicks ? elapsed : periodTicks);
+        if (updates < CLOCK_LOCK_UPDATES)
+            updates++;
+    }
+    anchorTime = time;
+
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Fails until the loop has settled or when the last update is too old to
+// extrapolate from; callers then read the hardware counter instead.
+inline bool AMDMicrophoneClock::predict(UInt64 time, UInt64* frame) const
+{
+    UInt32 before, after;
+    UInt64 anchor;
+    double position, frameRate;
+    UInt32 count;
+
+    do {
+        before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+        anchor = anchorTime;
+        position = anchorFrame;
+        frameRate = rate;
+        count = updates;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+
+    if (count < CLOCK_LOCK_UPDATES)
+        return false;
+
+    // A caller may have sampled its time just before a concurrent update.
+    if (time < anchor)
+        position -= frameRate * (anchor - time);
+    else if (time - anchor > staleTicks)
+        return false;
+    else
+        position += frameRate * (time - anchor);
+    *frame = position > 0.0 ? (UInt64)position : 0;
+
+    return true;
+}
+
+// Host time at which the model places the given frame. Called from the
+// updating thread only.
+inline UInt64 AMDMicrophoneClock::timeAt(UInt64 frame) const
+{
+    double offset = ((double)frame - anchorFrame) / rate;
+
+    if (offset < 0.0 && (UInt64)-offset > anchorTime)
+        return 0;
+
+    return offset < 0.0 ? anchorTime - (UInt64)-offset : anchorTime + (UInt64)offset;
+}
+
+// Host time of a frame for callers on other threads. Fails like predict()
+// while the loop has not settled.
+inline bool AMDMicrophoneClock::predictTime(UInt64 frame, UInt64* time) const
+{
+    UInt32 before, after;
+    UInt64 anchor;
+    double position, frameRate, offset;
+    UInt32 count;
+
+    do {
+        before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+        anchor = anchorTime;
+        position = anchorFrame;
+        frameRate = rate;
+        count = updates;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+
+    if (count < CLOCK_LOCK_UPDATES)
+        return false;
+
+    offset = ((double)frame - position) / frameRate;
+    if (offset < 0.0 && (UInt64)-offset > anchor)
+        return false;
+    *time = offset < 0.0 ? anchor - (UInt64)-offset : anchor + (UInt64)offset;
+
+    return true;
+}
+
+#endif /* AMDMicrophoneClock_hpp */
@@ -11,292 +11,462 @@
 #include "AMDMicrophoneEngine.hpp"
 
 #include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
 #include <IOKit/pci/IOPCIDevice.h>
+#include <kern/clock.h>
 
 #define super IOAudioDevice
 
-OSDefineMetaClassAndStructors(AMDMicrophoneDevice, IOAudioDevice);
+// Listening captures the engine's channels into its ring with a watermark
+// every LISTEN_INTERVAL_MS, 12.5 interrupts per second instead of 50 or
+// more, or every half ring if the ring holds less than two of them.
+#define LISTEN_INTERVAL_MS 80
 
-UInt32 AMDMicrophoneDevice::readl(UInt32 reg)
-{
-    return *(const volatile UInt32*)(baseAddr + reg - ACP_PHY_BASE_ADDRESS);
-}
+// The DMA runs on between the last counter read and the stop; the pre-roll
+// keeps this far clear of the frames it may have overwritten.
+#define LISTEN_STOP_MARGIN_MS 10
 
-void AMDMicrophoneDevice::writel(UInt32 val, UInt32 reg)
-{
-    *(volatile UInt32*)(baseAddr + reg - ACP_PHY_BASE_ADDRESS) = val;
-}
-
-void AMDMicrophoneDevice::configDMA()
-{
-    UInt32 low, high, val;
+OSDefineMetaClassAndStructors(AMDMicrophoneDevice, IOAudioDevice);
 
-    val = 0;
+#define ACP_GENERATION(Map)                                                                                      \
+    { &AMDMicrophoneChipFor<Map>::ops, &AMDMicrophoneDevice::interruptHandler<Map>,                             \
+      &AMDMicrophoneEngine::getCurrentSampleFrameFor<Map>, &AMDMicrophoneEngine::convertInputSamplesFor<Map> },
 
-    writel(ACP_SRAM_PTE_OFFSET | BIT(31), ACP_AXI2AXI_ATU_BASE_ADDR_GRP_1);
-    writel(ACP_PAGE_SIZE_4K_ENABLE, ACP_AXI2AXI_ATU_PAGE_SIZE_GRP_1);
+const AMDMicrophoneGeneration AMDMicrophoneDevice::supportedGenerations[] = { ACP_SUPPORTED_MAPS(ACP_GENERATION) };
 
+// Walks the descriptor one physical segment at a time and merges adjacent
+// segments into runs. Fails unless the whole ring is covered.
+bool AMDMicrophoneDevice::configDMA()
+{
     IOByteCount offset = 0;
-    while (offset < dmaDescriptor->getLength()) {
+
+    dmaRunCount = 0;
+    dmaPageCount = 0;
+    while (offset < dmaBufferSize && dmaPageCount < DMA_MAX_PAGES) {
         IOByteCount segmentLength = 0;
         addr64_t address = dmaDescriptor->getPhysicalSegment(offset, &segmentLength);
+        UInt32 pages;
 
-        if (!address || !segmentLength)
+        if (!address || !segmentLength || (address & (ACP_DMA_PAGE_SIZE - 1)))
             break;
 
-        low = (UInt32)address;
-        high = (UInt32)(address >> 32);
+        pages = (UInt32)((segmentLength + ACP_DMA_PAGE_SIZE - 1) / ACP_DMA_PAGE_SIZE);
+        if (pages > DMA_MAX_PAGES - dmaPageCount)
+            pages = DMA_MAX_PAGES - dmaPageCount;
 
-        writel(low, ACP_SCRATCH_REG_0 + val);
-        high |= BIT(31);
-        writel(high, ACP_SCRATCH_REG_0 + val + 4);
-        offset += ACP_DMA_PAGE_SIZE;
-        val += 8;
+        if (dmaRunCount && dmaRuns[dmaRunCount - 1].address + dmaRuns[dmaRunCount - 1].pages * ACP_DMA_PAGE_SIZE == address)
+            dmaRuns[dmaRunCount - 1].pages += pages;
+        else {
+            dmaRuns[dmaRunCount].address = address;
+            dmaRuns[dmaRunCount].pages = pages;
+            dmaRunCount++;
+        }
+        dmaPageCount += pages;
+        offset += pages * ACP_DMA_PAGE_SIZE;
     }
+
+    setProperty("DMABufferRuns", dmaRunCount, 32);
+
+    return offset >= dmaBufferSize;
 }
 
 void AMDMicrophoneDevice::clearDMABuffer()
 {
-    UInt8* buffer = (UInt8*)dmaDescriptor->getBytesNoCopy();
+    void* buffer = dmaDescriptor->getBytesNoCopy();
 
     if (!buffer)
         return;
 
-    for (UInt32 index = 0; index < BUFFER_SIZE; index++)
-        buffer[index] = 0;
+    bzero(buffer, dmaBufferSize);
 }
 
-void AMDMicrophoneDevice::disableInterrupt()
+// The tap is allocated up front so the audio thread never sees it appear or
+// go away; clients map it read-only.
+bool AMDMicrophoneDevice::createTap()
 {
-    writel(ACP_EXT_INTR_STAT_CLEAR_MASK, ACP_EXTERNAL_INTR_STAT);
-    writel(0x0, ACP_EXTERNAL_INTR_ENB);
+    UInt64 ticksPerSecond;
+
+    tapDescriptor = IOBufferMemoryDescriptor::inTaskWithOptions(
+        kernel_task, kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(AMDMicrophoneTapBuffer)
+    );
+    if (!tapDescriptor)
+        return false;
+
+    bzero(tapDescriptor->getBytesNoCopy(), sizeof(AMDMicrophoneTapBuffer));
+    nanoseconds_to_absolutetime(1000000000ULL, &ticksPerSecond);
+    tap.attach((AMDMicrophoneTapBuffer*)tapDescriptor->getBytesNoCopy(), ticksPerSecond);
+
+    return true;
+}
+
+bool AMDMicrophoneDevice::createTrace()
+{
+    traceDescriptor = IOBufferMemoryDescriptor::inTaskWithOptions(
+        kernel_task, kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(AMDMicrophoneTraceBuffer)
+    );
+    if (!traceDescriptor)
+        return false;
+
+    bzero(traceDescriptor->getBytesNoCopy(), sizeof(AMDMicrophoneTraceBuffer));
+    trace.attach((AMDMicrophoneTraceBuffer*)traceDescriptor->getBytesNoCopy(), dmaBufferSize, dmaPageCount);
+    generation->chip->setTrace(acp, &trace);
+
+    return true;
 }
 
-void AMDMicrophoneDevice::enableClock()
+bool AMDMicrophoneDevice::createAudioEngine()
 {
-    UInt32 val;
+    bool result = false;
 
-    writel(ACP_PDM_CLK_FREQ_MASK, ACP_WOV_CLK_CTRL);
-    val = readl(ACP_WOV_MISC_CTRL);
-    val &= ~ACP_WOV_GAIN_CONTROL;
-    val |= (ACP_WOV_PDM_GAIN << ACP_WOV_GAIN_CONTROL_SHIFT) & ACP_WOV_GAIN_CONTROL;
-    writel(val, ACP_WOV_MISC_CTRL);
+    audioEngine = new AMDMicrophoneEngine;
+    if (!audioEngine)
+        goto Done;
+
+    if (!audioEngine->init(this))
+        goto Done;
+
+    if (activateAudioEngine(audioEngine) != kIOReturnSuccess)
+        goto Done;
+
+    result = true;
+
+Done:
+    if (audioEngine != NULL) {
+        audioEngine->release();
+    }
+
+    return result;
+}
+
+int AMDMicrophoneDevice::findMSIInterruptTypeIndex()
+{
+    IOReturn ret;
+    int index, source = 0;
+    for (index = 0;; index++) {
+        int interruptType;
+        ret = pciDevice->getInterruptType(index, &interruptType);
+        if (ret != kIOReturnSuccess)
+            break;
+        if (interruptType & kIOInterruptTypePCIMessaged) {
+            source = index;
+            break;
+        }
+    }
+    return source;
 }
 
-void AMDMicrophoneDevice::enableInterrupt()
+template <typename Map>
+void AMDMicrophoneDevice::interruptHandler()
 {
-    writel(0x1, ACP_EXTERNAL_INTR_ENB);
-    writel(ACP_PDM_DMA_INTR_MASK, ACP_EXTERNAL_INTR_CNTL);
+    AMDMicrophoneProbe probe(stats, kStatInterruptHandler);
+    AMDMicrophoneTraceScope scope(trace, kTraceEntryInterrupt);
+    AMDMicrophoneChipACP<Map>* chip = AMDMicrophoneChipFor<Map>::from(acp);
+    UInt64 before, after, byteCount;
+
+    if (!chip->acknowledgeInterrupt())
+        return;
+    scope.result = 1;
+
+    if (listening) {
+        listenInterrupt(chip->getRelativeByteCount());
+        return;
+    }
+
+    // Pair the counter with the midpoint of the host times around the
+    // uncached read.
+    clock_get_uptime(&before);
+    byteCount = chip->getRelativeByteCount();
+    clock_get_uptime(&after);
+
+    audioEngine->updateClock(before + (after - before) / 2, byteCount);
 }
 
-UInt64 AMDMicrophoneDevice::getByteCount()
+// Runs the detector over the frames captured since the last watermark. If
+// the interrupt came so late that the ring lapped, only the newest ring's
+// worth is looked at.
+void AMDMicrophoneDevice::listenInterrupt(UInt64 byteCount)
 {
-    UInt32 low, high;
+    AMDMicrophoneProbe probe(stats, kStatVoiceDetector);
+    const SInt32* ring = (const SInt32*)dmaDescriptor->getBytesNoCopy();
+    UInt32 ringFrames = dmaBufferSize / listenFrameSize;
+    UInt64 frame = byteCount / listenFrameSize;
+
+    listenInterrupts++;
+    if (frame - listenFrame > ringFrames)
+        listenFrame = frame - ringFrames;
+
+    if (vad.process(ring, ringFrames, listenChannels, (UInt32)(listenFrame % ringFrames), (UInt32)(frame - listenFrame))) {
+        speechDetections++;
+        setProperty("SpeechDetections", speechDetections, 64);
+        messageClients(kAMDMicrophoneMessageSpeechStart);
+    }
+    listenFrame = frame;
+}
 
-    high = readl(ACP_WOV_RX_LINEARPOSITIONCNTR_HIGH);
-    low = readl(ACP_WOV_RX_LINEARPOSITIONCNTR_LOW);
+void AMDMicrophoneDevice::interruptOccurred(OSObject* owner, IOInterruptEventSource* src, int intCount)
+{
+    AMDMicrophoneDevice* that = (AMDMicrophoneDevice*)owner;
 
-    return ((UInt64)high << 32) | low;
+    if (that)
+        (that->*that->generation->interruptHandler)();
 }
 
-UInt64 AMDMicrophoneDevice::getRelativeByteCount()
+static UInt64 uptimeNanoseconds()
 {
-    UInt64 byteCount = getByteCount();
+    UInt64 uptime, nanoseconds;
 
-    if (byteCount < dmaStartByteCount)
-        return 0;
+    clock_get_uptime(&uptime);
+    absolutetime_to_nanoseconds(uptime, &nanoseconds);
 
-    return byteCount - dmaStartByteCount;
+    return nanoseconds;
 }
 
-void AMDMicrophoneDevice::initRingBuffer(UInt32 physAddr, UInt32 bufferSize, UInt32 watermarkSize)
+static void setNumber(OSDictionary* dictionary, const char* key, UInt64 value)
 {
-    writel(physAddr, ACP_WOV_RX_RINGBUFADDR);
-    writel(bufferSize, ACP_WOV_RX_RINGBUFSIZE);
-    writel(watermarkSize, ACP_WOV_RX_INTR_WATERMARK_SIZE);
-    writel(0x1, ACP_AXI2AXI_ATU_CTRL);
+    OSNumber* number = OSNumber::withNumber(value, 64);
+
+    if (number) {
+        dictionary->setObject(key, number);
+        number->release();
+    }
 }
 
-IOReturn AMDMicrophoneDevice::powerOff()
+OSDictionary* AMDMicrophoneDevice::copyStatistics() const
 {
-    UInt32 val;
-    UInt32 timeout;
+    OSDictionary* dictionary = OSDictionary::withCapacity(kStatCount + 2);
+
+    if (!dictionary)
+        return NULL;
 
-    writel(ACP_PGFSM_CNTL_POWER_OFF_MASK, ACP_PGFSM_CONTROL);
+    dictionary->setObject("Enabled", stats.enabled ? kOSBooleanTrue : kOSBooleanFalse);
+    setNumber(dictionary, "CyclesPerMicrosecond", stats.cyclesPerMicrosecond(uptimeNanoseconds()));
+
+    for (UInt32 index = 0; index < kStatCount; index++) {
+        const AMDMicrophoneStat* stat = &stats.stats[index];
+        OSDictionary* entry = OSDictionary::withCapacity(4);
+        OSArray* histogram = OSArray::withCapacity(STATS_HISTOGRAM_BUCKETS);
+
+        if (entry && histogram) {
+            setNumber(entry, "Calls", stat->calls);
+            setNumber(entry, "Cycles", stat->cycles);
+            setNumber(entry, "MaxCycles", stat->maxCycles);
+            for (UInt32 bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+                OSNumber* number = OSNumber::withNumber(stat->histogram[bucket], 64);
+
+                if (number) {
+                    histogram->setObject(number);
+                    number->release();
+                }
+            }
+            entry->setObject("Histogram", histogram);
+            dictionary->setObject(statNames[index], entry);
+        }
 
-    timeout = 0;
-    while (++timeout < 500) {
-        val = readl(ACP_PGFSM_STATUS);
-        if ((val & ACP_PGFSM_STATUS_MASK) == ACP_POWERED_OFF)
-            return kIOReturnSuccess;
-        IODelay(1);
+        if (entry)
+            entry->release();
+        if (histogram)
+            histogram->release();
     }
 
-    return kIOReturnTimeout;
+    return dictionary;
 }
 
-IOReturn AMDMicrophoneDevice::powerOn()
+OSDictionary* AMDMicrophoneDevice::copyXruns() const
 {
-    UInt32 val;
-    UInt32 timeout;
-
-    val = readl(ACP_PGFSM_STATUS);
-    if (val == 0)
-        return val;
-
-    if ((val & ACP_PGFSM_STATUS_MASK) != ACP_POWER_ON_IN_PROGRESS)
-        writel(ACP_PGFSM_CNTL_POWER_ON_MASK, ACP_PGFSM_CONTROL);
-
-    timeout = 0;
-    while (++timeout < 500) {
-        val = readl(ACP_PGFSM_STATUS);
-        if (!val)
-            return kIOReturnSuccess;
-        IODelay(1);
-    }
+    OSDictionary* dictionary = OSDictionary::withCapacity(3);
+
+    if (!dictionary)
+        return NULL;
 
-    return kIOReturnTimeout;
+    setNumber(dictionary, "Overruns", xrun.overruns);
+    setNumber(dictionary, "MissedInterrupts", xrun.missedInterrupts);
+    setNumber(dictionary, "CounterRegressions", generation->chip->status(acp).counterRegressions);
+
+    return dictionary;
 }
 
-IOReturn AMDMicrophoneDevice::reset()
+// Register accesses since the given snapshot of the shadow's counters.
+OSDictionary* AMDMicrophoneDevice::copyMMIOCounts(const AMDMicrophoneMMIOCounts& since) const
 {
-    UInt32 val;
-    UInt32 timeout;
-
-    writel(0x1, ACP_SOFT_RESET);
-    timeout = 0;
-    while (++timeout < 500) {
-        val = readl(ACP_SOFT_RESET);
-        if (val & ACP_SOFT_RESET_SOFTRESET_AUDDONE_MASK)
-            break;
-        cpu_relax();
-    }
-    writel(0x0, ACP_SOFT_RESET);
-    timeout = 0;
-    while (++timeout < 500) {
-        val = readl(ACP_SOFT_RESET);
-        if (!val)
-            return kIOReturnSuccess;
-        cpu_relax();
-    }
-    return kIOReturnTimeout;
+    AMDMicrophoneMMIOCounts counts = generation->chip->status(acp).counts;
+    OSDictionary* dictionary = OSDictionary::withCapacity(4);
+
+    if (!dictionary)
+        return NULL;
+
+    setNumber(dictionary, "Reads", counts.reads - since.reads);
+    setNumber(dictionary, "Writes", counts.writes - since.writes);
+    setNumber(dictionary, "ReadsAvoided", counts.readsAvoided - since.readsAvoided);
+    setNumber(dictionary, "WritesAvoided", counts.writesAvoided - since.writesAvoided);
+
+    return dictionary;
 }
 
-IOReturn AMDMicrophoneDevice::startDMA()
+IOReturn AMDMicrophoneDevice::powerUp()
 {
-    UInt32 val;
-    UInt32 timeout;
-
-    writel(0x1, ACP_WOV_PDM_FIFO_FLUSH);
-    enableClock();
-    writel(0x1, ACP_WOV_PDM_ENABLE);
-    writel(0x1, ACP_WOV_PDM_DMA_ENABLE);
-
-    timeout = 0;
-    while (++timeout < ACP_COUNTER) {
-        val = readl(ACP_WOV_PDM_DMA_ENABLE);
-        if ((val & 0x2) == ACP_PDM_DMA_EN_STATUS)
-            break;
-        IODelay(5);
-    }
+    IOReturn ret;
+
+    if (poweredOn)
+        return kIOReturnSuccess;
 
-    if (timeout == ACP_COUNTER)
-        return kIOReturnTimeout;
+    AMDMicrophoneTraceScope scope(trace, kTraceEntryPowerUp, dmaPageCount);
+    ret = generation->chip->powerUp(acp, dmaRuns, dmaRunCount);
+    scope.result = ret;
+    if (ret == kIOReturnIOError)
+        LOG("PTE read-back mismatch\n");
+    if (ret != kIOReturnSuccess)
+        return ret;
+    poweredOn = true;
 
-    dmaStartByteCount = getByteCount();
-    lastPeriodCount = 0;
     return kIOReturnSuccess;
 }
 
-IOReturn AMDMicrophoneDevice::stopDMA()
+void AMDMicrophoneDevice::powerDown()
 {
-    UInt32 val;
-    UInt32 timeout;
-
-    val = readl(ACP_WOV_PDM_DMA_ENABLE);
-    if (val & 0x1) {
-        writel(0x0, ACP_WOV_PDM_DMA_ENABLE);
-        timeout = 0;
-        while (++timeout < ACP_COUNTER) {
-            val = readl(ACP_WOV_PDM_DMA_ENABLE);
-            if (val == 0x0)
-                break;
-            IODelay(5);
-        }
-        if (timeout == ACP_COUNTER)
-            return kIOReturnTimeout;
-    }
+    if (!poweredOn)
+        return;
+
+    AMDMicrophoneTraceScope scope(trace, kTraceEntryPowerDown);
+    scope.result = generation->chip->powerDown(acp);
+    poweredOn = false;
+}
+
+// Called by the engine before it starts DMA. The wake time is published so
+// its share of the mic-open latency can be checked.
+IOReturn AMDMicrophoneDevice::wake()
+{
+    UInt64 start;
+    IOReturn ret;
 
-    val = readl(ACP_WOV_PDM_ENABLE);
-    if (val == 0x1)
-        writel(0x0, ACP_WOV_PDM_ENABLE);
+    if (idleTimer)
+        idleTimer->cancelTimeout();
 
-    writel(0x1, ACP_WOV_PDM_FIFO_FLUSH);
+    if (poweredOn)
+        return kIOReturnSuccess;
 
-    return kIOReturnSuccess;
+    start = uptimeNanoseconds();
+    ret = powerUp();
+    setProperty("WakeMicroseconds", (uptimeNanoseconds() - start) / 1000, 32);
+
+    return ret;
 }
 
-bool AMDMicrophoneDevice::createAudioEngine()
+// Capture start and stop for the engine and the listening capture, which
+// take turns on the one PDM ring.
+IOReturn AMDMicrophoneDevice::startCapture(UInt32 watermarkSize, UInt32 channels)
 {
-    bool result = false;
+    AMDMicrophoneTraceScope scope(trace, kTraceEntryStartCapture, TRACE_CAPTURE_ARGUMENT(watermarkSize, channels));
 
-    audioEngine = new AMDMicrophoneEngine;
-    if (!audioEngine)
-        goto Done;
+    scope.result = generation->chip->startCapture(acp, dmaBufferSize, watermarkSize, channels);
+    return scope.result;
+}
 
-    if (!audioEngine->init(this))
-        goto Done;
+IOReturn AMDMicrophoneDevice::stopCapture()
+{
+    AMDMicrophoneTraceScope scope(trace, kTraceEntryStopCapture);
 
-    if (activateAudioEngine(audioEngine) != kIOReturnSuccess)
-        goto Done;
+    scope.result = generation->chip->stopCapture(acp);
+    return scope.result;
+}
 
-    result = true;
+// Starts the listening capture if it is enabled and no app is recording.
+// Returns false if the ACP is left idle instead.
+bool AMDMicrophoneDevice::startListening()
+{
+    UInt32 watermarkFrames = SAMPLE_RATE * LISTEN_INTERVAL_MS / 1000;
 
-Done:
-    if (audioEngine != NULL) {
-        audioEngine->release();
+    if (!wakeOnVoice || listening)
+        return listening;
+
+    listenChannels = audioEngine->getCaptureChannels();
+    listenFrameSize = listenChannels * SAMPLE_WIDTH / 8;
+    if (watermarkFrames > dmaBufferSize / listenFrameSize / 2)
+        watermarkFrames = dmaBufferSize / listenFrameSize / 2;
+
+    if (wake() != kIOReturnSuccess)
+        return false;
+
+    clearDMABuffer();
+    vad.reset();
+    listenFrame = 0;
+    listening = startCapture(watermarkFrames * listenFrameSize, listenChannels) == kIOReturnSuccess;
+
+    return listening;
+}
+
+// Called by the engine before it takes over the ACP.
+void AMDMicrophoneDevice::stopListening()
+{
+    UInt64 frame;
+
+    if (!listening)
+        return;
+
+    {
+        AMDMicrophoneTraceScope scope(trace, kTraceEntryStopListening);
+        frame = generation->chip->getRelativeByteCount(acp) / listenFrameSize;
+        scope.result = generation->chip->stopCapture(acp);
     }
+    listening = false;
 
-    return result;
+    if (tap.isAttached())
+        handOverPreRoll(frame);
 }
 
-int AMDMicrophoneDevice::findMSIInterruptTypeIndex()
+// Copies the last preRollMilliseconds of the listening capture, still in
+// the DMA ring, to the capture tap as a 48 kHz chunk ending now. The engine's
+// own chunks follow it. A ring too small for the pre-roll shortens it.
+void AMDMicrophoneDevice::handOverPreRoll(UInt64 endFrame)
 {
-    IOReturn ret;
-    int index, source = 0;
-    for (index = 0;; index++) {
-        int interruptType;
-        ret = pciDevice->getInterruptType(index, &interruptType);
-        if (ret != kIOReturnSuccess)
-            break;
-        if (interruptType & kIOInterruptTypePCIMessaged) {
-            source = index;
-            break;
+    const SInt32* ring = (const SInt32*)dmaDescriptor->getBytesNoCopy();
+    UInt32 milliseconds = preRollMilliseconds < WAKE_ON_VOICE_MAX_PREROLL ? preRollMilliseconds : WAKE_ON_VOICE_MAX_PREROLL;
+    UInt64 frames = (UInt64)milliseconds * SAMPLE_RATE / 1000;
+    UInt32 ringFrames = dmaBufferSize / listenFrameSize;
+    UInt32 marginFrames = SAMPLE_RATE * LISTEN_STOP_MARGIN_MS / 1000;
+    const float scale = 1.0f / (2147483648.0f * listenChannels);
+    UInt64 now, duration;
+    float samples[CONVERT_BLOCK_FRAMES];
+
+    if (frames > ringFrames - marginFrames)
+        frames = ringFrames - marginFrames;
+    if (frames > endFrame)
+        frames = endFrame;
+    if (!frames)
+        return;
+
+    clock_get_uptime(&now);
+    nanoseconds_to_absolutetime(frames * 1000000000ULL / SAMPLE_RATE, &duration);
+    tap.mark(now - duration, SAMPLE_RATE);
+
+    for (UInt64 frame = endFrame - frames; frame < endFrame;) {
+        UInt32 count = endFrame - frame < CONVERT_BLOCK_FRAMES ? (UInt32)(endFrame - frame) : CONVERT_BLOCK_FRAMES;
+
+        for (UInt32 index = 0; index < count; index++) {
+            const SInt32* source = &ring[((frame + index) % ringFrames) * listenChannels];
+            float sum = 0.0f;
+
+            for (UInt32 channel = 0; channel < listenChannels; channel++)
+                sum += (float)source[channel];
+            samples[index] = sum * scale;
         }
+        tap.write(samples, count);
+        frame += count;
     }
-    return source;
 }
 
-void AMDMicrophoneDevice::interruptHandler()
+void AMDMicrophoneDevice::scheduleIdlePowerOff()
 {
-    UInt32 val;
-    UInt64 byteCount;
-
-    val = readl(ACP_EXTERNAL_INTR_STAT);
-    if (val & BIT(ACP_PDM_DMA_STAT)) {
-        writel(BIT(ACP_PDM_DMA_STAT), ACP_EXTERNAL_INTR_STAT);
-        byteCount = getRelativeByteCount();
-        if (byteCount % BUFFER_SIZE == 0)
-            audioEngine->takeTimeStamp();
-    }
+    if (idleTimer && idlePowerOffSeconds)
+        idleTimer->setTimeoutMS(idlePowerOffSeconds * 1000);
 }
 
-void AMDMicrophoneDevice::interruptOccurred(OSObject* owner, IOInterruptEventSource* src, int intCount)
+void AMDMicrophoneDevice::idleTimerFired(OSObject* owner, IOTimerEventSource* sender)
 {
     AMDMicrophoneDevice* that = (AMDMicrophoneDevice*)owner;
 
+    // Runs on the work loop, serialized with engine start, which cancels it.
     if (that)
-        that->interruptHandler();
+        that->powerDown();
 }
 
 IOService* AMDMicrophoneDevice::probe(IOService* provider, SInt32* score)
@@ -304,21 +474,34 @@ IOService* AMDMicrophoneDevice::probe(IOService* provider, SInt32* score)
     pciDevice = OSDynamicCast(IOPCIDevice, provider);
 
     UInt8 revisionId = pciDevice->configRead8(kIOPCIConfigRevisionID);
+    const char* name = "unknown";
 
-    if (revisionId == 0x1)
-        LOG("AMD Digital Microphone for Renoir\n");
-    else {
-        LOG("Only Renoir is supported at the moment\n");
-        return NULL;
+    for (UInt32 index = 0; index < sizeof(supportedGenerations) / sizeof(supportedGenerations[0]); index++) {
+        if (supportedGenerations[index].chip->matches(revisionId))
+            generation = &supportedGenerations[index];
     }
 
-    return this;
+    if (generation) {
+        LOG("AMD Digital Microphone for %s\n", generation->chip->name);
+        return this;
+    }
+
+    for (UInt32 index = 0; index < sizeof(unsupportedGenerations) / sizeof(unsupportedGenerations[0]); index++) {
+        if (unsupportedGenerations[index].revision == revisionId)
+            name = unsupportedGenerations[index].name;
+    }
+    LOG("ACP revision 0x%x (%s) is not supported\n", revisionId, name);
+
+    return NULL;
 }
 
 bool AMDMicrophoneDevice::initHardware(IOService* provider)
 {
     bool result = false;
     IOWorkLoop* workLoop;
+    OSNumber* idlePowerOffNumber;
+    OSNumber* preRollNumber;
+    OSNumber* bufferSizeNumber;
 
     if (!super::initHardware(provider)) {
         goto Done;
@@ -337,17 +520,40 @@ bool AMDMicrophoneDevice::initHardware(IOService* provider)
     if (!baseAddrMap)
         goto Done;
 
-    baseAddr = baseAddrMap->getVirtualAddress();
-    if (!baseAddr)
+    if (baseAddrMap->getLength() < generation->chip->barSize) {
+        LOG("BAR0 is 0x%llx bytes, %s needs 0x%x\n", (UInt64)baseAddrMap->getLength(), generation->chip->name,
+            generation->chip->barSize);
+        goto Done;
+    }
+
+    if (!baseAddrMap->getVirtualAddress())
+        goto Done;
+    acp = generation->chip->create(baseAddrMap->getVirtualAddress());
+    if (!acp)
         goto Done;
 
-    dmaDescriptor = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionIn, BUFFER_SIZE);
+    dmaBufferSize = BUFFER_SIZE;
+    bufferSizeNumber = OSDynamicCast(OSNumber, getProperty(DMA_BUFFER_SIZE_KEY));
+    if (bufferSizeNumber) {
+        dmaBufferSize = bufferSizeNumber->unsigned32BitValue() / BUFFER_SIZE * BUFFER_SIZE;
+        if (dmaBufferSize < BUFFER_SIZE)
+            dmaBufferSize = BUFFER_SIZE;
+        if (dmaBufferSize > DMA_MAX_SIZE)
+            dmaBufferSize = DMA_MAX_SIZE / BUFFER_SIZE * BUFFER_SIZE;
+    }
+    setProperty(DMA_BUFFER_SIZE_KEY, dmaBufferSize, 32);
+
+    dmaDescriptor = IOBufferMemoryDescriptor::inTaskWithOptions(
+        kernel_task, kIODirectionIn, dmaBufferSize, ACP_DMA_PAGE_SIZE
+    );
     if (!dmaDescriptor)
         goto Done;
     if (dmaDescriptor->prepare(kIODirectionIn) != kIOReturnSuccess)
         goto Done;
     dmaPrepared = true;
     clearDMABuffer();
+    if (!configDMA())
+        goto Done;
 
     workLoop = getWorkLoop();
     if (!workLoop)
@@ -364,19 +570,33 @@ bool AMDMicrophoneDevice::initHardware(IOService* provider)
 
     irqEventSource->enable();
 
-    if (!createAudioEngine())
+    idleTimer = IOTimerEventSource::timerEventSource(
+        this, (IOTimerEventSource::Action)&AMDMicrophoneDevice::idleTimerFired
+    );
+    if (!idleTimer || workLoop->addEventSource(idleTimer) != kIOReturnSuccess)
         goto Done;
 
-    if (powerOn() != kIOReturnSuccess)
-        goto Done;
+    idlePowerOffNumber = OSDynamicCast(OSNumber, getProperty(IDLE_POWER_OFF_KEY));
+    if (idlePowerOffNumber)
+        idlePowerOffSeconds = idlePowerOffNumber->unsigned32BitValue();
 
-    writel(0x1, ACP_CONTROL);
-    if (reset() != kIOReturnSuccess)
+    wakeOnVoice = getProperty(WAKE_ON_VOICE_KEY) == kOSBooleanTrue;
+    preRollNumber = OSDynamicCast(OSNumber, getProperty(WAKE_ON_VOICE_PREROLL_KEY));
+    if (preRollNumber)
+        preRollMilliseconds = preRollNumber->unsigned32BitValue();
+
+    if (getProperty(CAPTURE_TAP_KEY) == kOSBooleanTrue && !createTap())
+        goto Done;
+    if (getProperty(REGISTER_TRACE_KEY) == kOSBooleanTrue && !createTrace())
         goto Done;
 
-    writel(0x3, ACP_CLKMUX_SEL);
+    if (!createAudioEngine())
+        goto Done;
 
-    configDMA();
+    if (powerUp() != kIOReturnSuccess)
+        goto Done;
+    if (!startListening())
+        scheduleIdlePowerOff();
 
     result = true;
 
@@ -390,19 +610,91 @@ Done:
 void AMDMicrophoneDevice::stop(IOService* provider)
 {
     irqEventSource->disable();
-    reset();
+    if (idleTimer)
+        idleTimer->cancelTimeout();
+
+    if (listening) {
+        stopCapture();
+        listening = false;
+    }
 
-    writel(0x0, ACP_CLKMUX_SEL);
-    writel(0x0, ACP_CONTROL);
+    powerDown();
+}
+
+// Statistics are snapshotted whenever the registry is read, e.g. by ioreg.
+bool AMDMicrophoneDevice::serializeProperties(OSSerialize* serializer) const
+{
+    OSDictionary* statistics = copyStatistics();
+    OSDictionary* xruns = copyXruns();
+    OSDictionary* mmio = copyMMIOCounts(AMDMicrophoneMMIOCounts());
+
+    if (statistics) {
+        const_cast<AMDMicrophoneDevice*>(this)->setProperty(STATISTICS_KEY, statistics);
+        statistics->release();
+    }
+    if (xruns) {
+        const_cast<AMDMicrophoneDevice*>(this)->setProperty(XRUNS_KEY, xruns);
+        xruns->release();
+    }
+    if (mmio) {
+        const_cast<AMDMicrophoneDevice*>(this)->setProperty(MMIO_KEY, mmio);
+        mmio->release();
+    }
+    if (wakeOnVoice)
+        const_cast<AMDMicrophoneDevice*>(this)->setProperty("ListenInterrupts", listenInterrupts, 64);
+
+    return super::serializeProperties(serializer);
+}
+
+IOReturn AMDMicrophoneDevice::setProperties(OSObject* properties)
+{
+    OSDictionary* dictionary = OSDynamicCast(OSDictionary, properties);
+    OSBoolean* enabled;
+
+    if (!dictionary)
+        return kIOReturnBadArgument;
+
+    enabled = OSDynamicCast(OSBoolean, dictionary->getObject(STATISTICS_ENABLED_KEY));
+    if (!enabled)
+        return kIOReturnUnsupported;
+
+    if (enabled->isTrue())
+        stats.enable(uptimeNanoseconds());
+    else
+        stats.disable();
+
+    return kIOReturnSuccess;
 }
 
 void AMDMicrophoneDevice::free()
 {
+    if (idleTimer) {
+        if (getWorkLoop())
+            getWorkLoop()->removeEventSource(idleTimer);
+        idleTimer->release();
+        idleTimer = NULL;
+    }
+
     if (baseAddrMap) {
         baseAddrMap->release();
         baseAddrMap = NULL;
     }
 
+    if (acp) {
+        generation->chip->destroy(acp);
+        acp = NULL;
+    }
+
+    if (tapDescriptor) {
+        tapDescriptor->release();
+        tapDescriptor = NULL;
+    }
+
+    if (traceDescriptor) {
+        traceDescriptor->release();
+        traceDescriptor = NULL;
+    }
+
     if (dmaDescriptor) {
         if (dmaPrepared) {
             dmaDescriptor->complete(kIODirectionIn);
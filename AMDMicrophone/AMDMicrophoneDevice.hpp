@@ -8,106 +8,148 @@
 #ifndef AMDMicrophoneDevice_hpp
 #define AMDMicrophoneDevice_hpp
 
+#include "AMDMicrophoneChip.hpp"
+#include "AMDMicrophoneStats.hpp"
+#include "AMDMicrophoneTap.hpp"
+#include "AMDMicrophoneTrace.hpp"
+#include "AMDMicrophoneVAD.hpp"
+#include "AMDMicrophoneXrun.hpp"
+
+#include <IOKit/IOLib.h>
 #include <IOKit/audio/IOAudioDevice.h>
 
-#define ACP_PHY_BASE_ADDRESS               0x1240000
-#define ACP_AXI2AXI_ATU_PAGE_SIZE_GRP_1    0x1240C00
-#define ACP_AXI2AXI_ATU_BASE_ADDR_GRP_1    0x1240C04
-#define ACP_AXI2AXI_ATU_CTRL               0x1240C40
-#define ACP_SOFT_RESET                     0x1241000
-#define ACP_CONTROL                        0x1241004
-#define ACP_EXTERNAL_INTR_ENB              0x1241800
-#define ACP_EXTERNAL_INTR_CNTL             0x1241804
-#define ACP_EXTERNAL_INTR_STAT             0x1241808
-#define ACP_PGFSM_CONTROL                  0x124141C
-#define ACP_PGFSM_STATUS                   0x1241420
-#define ACP_CLKMUX_SEL                     0x1241424
-#define ACP_WOV_PDM_ENABLE                 0x1242C04
-#define ACP_WOV_PDM_DMA_ENABLE             0x1242C08
-#define ACP_WOV_RX_RINGBUFADDR             0x1242C0C
-#define ACP_WOV_RX_RINGBUFSIZE             0x1242C10
-#define ACP_WOV_RX_LINEARPOSITIONCNTR_HIGH 0x1242C18
-#define ACP_WOV_RX_LINEARPOSITIONCNTR_LOW  0x1242C1C
-#define ACP_WOV_RX_INTR_WATERMARK_SIZE     0x1242C20
-#define ACP_WOV_PDM_FIFO_FLUSH             0x1242C24
-#define ACP_WOV_PDM_NO_OF_CHANNELS         0x1242C28
-#define ACP_WOV_PDM_DECIMATION_FACTOR      0x1242C2C
-#define ACP_WOV_MISC_CTRL                  0x1242C5C
-#define ACP_WOV_CLK_CTRL                   0x1242C60
-#define ACP_SCRATCH_REG_0                  0x1250000
-
-#define ACP_ERROR_MASK                        0x20000000
-#define ACP_EXT_INTR_STAT_CLEAR_MASK          0xFFFFFFFF
-#define ACP_PDM_CLK_FREQ_MASK                 0x7
-#define ACP_PDM_DMA_INTR_MASK                 0x10000
-#define ACP_PGFSM_CNTL_POWER_OFF_MASK         0x0
-#define ACP_PGFSM_CNTL_POWER_ON_MASK          0x1
-#define ACP_PGFSM_STATUS_MASK                 0x3
-#define ACP_SOFT_RESET_SOFTRESET_AUDDONE_MASK 0x10001
-#define ACP_WOV_GAIN_CONTROL                  0x18
-#define ACP_WOV_GAIN_CONTROL_SHIFT            0x3
-#define ACP_WOV_PDM_GAIN                      0x2
-
-#define ACP_COUNTER               20000
-#define ACP_DMA_PAGE_SIZE         4096
-#define ACP_MEM_WINDOW_START      0x4000000
-#define ACP_PAGE_SIZE_4K_ENABLE   0x2
-#define ACP_PDM_DECIMATION_FACTOR 0x2
-#define ACP_PDM_DMA_EN_STATUS     0x2
-#define ACP_PDM_DMA_STAT          0x10
-#define ACP_POWER_ON_IN_PROGRESS  0x1
-#define ACP_POWERED_OFF           0x2
-#define ACP_SRAM_PTE_OFFSET       0x2050000
-
-#define BIT(n)      (1UL << (n))
-#define cpu_relax() asm volatile("rep; nop")
+#define STATISTICS_KEY         "Statistics"
+#define STATISTICS_ENABLED_KEY "StatisticsEnabled"
+#define XRUNS_KEY              "Xruns"
+#define MMIO_KEY               "MMIO"
+#define MMIO_CYCLE_KEY         "LastCycleMMIO"
+
+#define IDLE_POWER_OFF_KEY     "IdlePowerOffSeconds"
+#define IDLE_POWER_OFF_SECONDS 30
+
+// Boolean; shares the processed signal through AMDMicrophoneUserClient.
+#define CAPTURE_TAP_KEY "CaptureTap"
+
+// Boolean; records register accesses, interrupts and conversions for
+// AMDMicrophoneUserClient. PTE values are masked so the trace carries no
+// physical addresses.
+#define REGISTER_TRACE_KEY "RegisterTrace"
+
+// Boolean; keeps the microphone listening while no app records and sends
+// kAMDMicrophoneMessageSpeechStart to interested clients when speech starts.
+// The pre-roll is copied to the capture tap when recording starts.
+#define WAKE_ON_VOICE_KEY         "WakeOnVoice"
+#define WAKE_ON_VOICE_PREROLL_KEY "WakeOnVoicePreRollMilliseconds"
+#define WAKE_ON_VOICE_PREROLL_MS  100
+#define WAKE_ON_VOICE_MAX_PREROLL 150
+
+#define kAMDMicrophoneMessageSpeechStart iokit_vendor_specific_msg(1)
+
+// PTE slots claimed in the ACP scratch SRAM, one 4 KB page each. This caps
+// the DMA ring at DMA_MAX_SIZE.
+#define DMA_MAX_PAGES (ACP_PTE_WINDOW / 8)
+#define DMA_MAX_SIZE  (DMA_MAX_PAGES * ACP_DMA_PAGE_SIZE)
 
+class AMDMicrophoneDevice;
 class AMDMicrophoneEngine;
 class IOInterruptEventSource;
 class IOPCIDevice;
+class IOTimerEventSource;
+
+// One ACP generation: the work-loop entry points of its register code, and
+// the interrupt handler and engine conversion paths compiled for its map, so
+// their register accesses are direct calls. probe() binds one; only the
+// entry into a hot path goes through this table.
+struct AMDMicrophoneGeneration {
+    const AMDMicrophoneChipOps* chip;
+    void (AMDMicrophoneDevice::*interruptHandler)();
+    UInt32 (AMDMicrophoneEngine::*getCurrentSampleFrame)();
+    IOReturn (AMDMicrophoneEngine::*convertInputSamples)(
+        const void* sampleBuf, void* destBuf, UInt32 firstSampleFrame, UInt32 numSampleFrames,
+        const IOAudioStreamFormat* streamFormat, IOAudioStream* audioStream
+    );
+};
 
 class AMDMicrophoneDevice : public IOAudioDevice {
     OSDeclareDefaultStructors(AMDMicrophoneDevice);
 
     friend class AMDMicrophoneEngine;
+    friend class AMDMicrophoneUserClient;
 
     AMDMicrophoneEngine* audioEngine;
     IOInterruptEventSource* irqEventSource;
+    IOTimerEventSource* idleTimer = NULL;
     IOPCIDevice* pciDevice;
     IOMemoryMap* baseAddrMap;
-    IOVirtualAddress baseAddr;
     IOBufferMemoryDescriptor* dmaDescriptor;
-    UInt64 dmaStartByteCount = 0;
-    UInt64 lastPeriodCount = 0;
+    // The ACP generation probe() found, and its register path, an
+    // AMDMicrophoneChipACP of that generation's map.
+    const AMDMicrophoneGeneration* generation = NULL;
+    void* acp = NULL;
     bool dmaPrepared = false;
+    AMDMicrophoneStats stats;
+    AMDMicrophoneXrun xrun;
+    IOBufferMemoryDescriptor* tapDescriptor = NULL;
+    AMDMicrophoneTap tap;
+    IOBufferMemoryDescriptor* traceDescriptor = NULL;
+    AMDMicrophoneTrace trace;
+
+    AMDMicrophoneVAD vad;
+    bool wakeOnVoice = false;
+    bool listening = false;
+    UInt64 listenFrame = 0;
+    UInt32 listenChannels = 0;
+    UInt32 listenFrameSize = 0;
+    UInt32 preRollMilliseconds = WAKE_ON_VOICE_PREROLL_MS;
+    UInt64 listenInterrupts = 0;
+    UInt64 speechDetections = 0;
 
-    UInt32 readl(UInt32 reg);
-    void writel(UInt32 val, UInt32 reg);
+    // Physically contiguous runs of the DMA buffer, recorded once so the
+    // PTEs can be rewritten after a power cycle without walking the
+    // descriptor.
+    AMDMicrophoneDMARun dmaRuns[DMA_MAX_PAGES];
+    UInt32 dmaRunCount = 0;
+    UInt32 dmaPageCount = 0;
+    UInt32 dmaBufferSize = 0;
+    UInt32 idlePowerOffSeconds = IDLE_POWER_OFF_SECONDS;
+    bool poweredOn = false;
 
-    void configDMA();
+    bool configDMA();
     void clearDMABuffer();
-    void disableInterrupt();
-    void enableClock();
-    void enableInterrupt();
-    UInt64 getByteCount();
-    UInt64 getRelativeByteCount();
-    void initRingBuffer(UInt32 physAddr, UInt32 bufferSize, UInt32 watermarkSize);
-    IOReturn powerOff();
-    IOReturn powerOn();
-    IOReturn reset();
-    IOReturn startDMA();
-    IOReturn stopDMA();
+    bool createTap();
+    bool createTrace();
+
+    IOReturn powerUp();
+    void powerDown();
+    IOReturn wake();
+    IOReturn startCapture(UInt32 watermarkSize, UInt32 channels);
+    IOReturn stopCapture();
+    void scheduleIdlePowerOff();
+    bool startListening();
+    void stopListening();
+    void listenInterrupt(UInt64 byteCount);
+    void handOverPreRoll(UInt64 endFrame);
+    static void idleTimerFired(OSObject* owner, IOTimerEventSource* sender);
 
     bool createAudioEngine();
     int findMSIInterruptTypeIndex();
+    template <typename Map>
     void interruptHandler();
     static void interruptOccurred(OSObject* owner, IOInterruptEventSource* src, int intCount);
+    OSDictionary* copyStatistics() const;
+    OSDictionary* copyXruns() const;
+    OSDictionary* copyMMIOCounts(const AMDMicrophoneMMIOCounts& since) const;
+
+    static const AMDMicrophoneGeneration supportedGenerations[];
 
 public:
     IOService* probe(IOService* provider, SInt32* score) override;
     bool initHardware(IOService* provider) override;
     void stop(IOService* provider) override;
     void free() override;
+
+    bool serializeProperties(OSSerialize* serializer) const override;
+    IOReturn setProperties(OSObject* properties) override;
 };
 
 #endif /* AMDMicrophoneDevice_hpp */
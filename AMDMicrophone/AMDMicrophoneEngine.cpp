@@ -14,18 +14,159 @@
 #include <IOKit/audio/IOAudioDevice.h>
 #include <IOKit/audio/IOAudioLevelControl.h>
 #include <IOKit/audio/IOAudioToggleControl.h>
+#include <kern/clock.h>
 
 #define super IOAudioEngine
 
 OSDefineMetaClassAndStructors(AMDMicrophoneEngine, IOAudioEngine);
 
+// Capture profiles selectable through the LatencyProfile property. The ring
+// buffer keeps its size in all of them; a profile only splits it into more,
+// shorter periods. The watermark interrupt fires once per period and the
+// input safety offset is kept at two periods.
+static const struct {
+    const char* name;
+    UInt32 periodFrames;
+} latencyProfiles[] = {
+    { "Default", PERIOD_FRAMES },
+    { "Low", 256 },
+    { "UltraLow", 128 },
+};
+
+// Formats offered to clients. The ring holds 32-bit samples from two or four
+// microphones; these only change what convertInputSamples writes. Mixable formats are
+// handed to the HAL as float, the 16-bit ones are copied out as integers.
+static const struct {
+    UInt32 numChannels;
+    UInt32 bitWidth;
+} clientFormats[] = {
+    { NUM_CHANNELS, SAMPLE_WIDTH },
+    { 1, SAMPLE_WIDTH },
+    { NUM_CHANNELS, 16 },
+    { 1, 16 },
+};
+
+static UInt32 microsecondsSince(AbsoluteTime since)
+{
+    UInt64 now, nanoseconds;
+
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - since, &nanoseconds);
+
+    return (UInt32)(nanoseconds / 1000);
+}
+
+// Picks the PDM channel count and derives the per-channel steering delays
+// for a linear array: channel i lags by i * spacing * sin(angle) / c, shifted
+// so the earliest channel has no delay.
+void AMDMicrophoneEngine::selectCaptureChannels()
+{
+    OSNumber* channelsNumber = OSDynamicCast(OSNumber, audioDevice->getProperty(PDM_CHANNELS_KEY));
+    OSNumber* spacingNumber = OSDynamicCast(OSNumber, audioDevice->getProperty(MIC_SPACING_KEY));
+    OSNumber* angleNumber = OSDynamicCast(OSNumber, audioDevice->getProperty(BEAM_ANGLE_KEY));
+    float delays[RESAMPLER_MAX_CHANNELS];
+    double step = 0.0;
+
+    captureChannels = NUM_CHANNELS;
+    if (channelsNumber) {
+        if (channelsNumber->unsigned32BitValue() == 4)
+            captureChannels = 4;
+        else if (channelsNumber->unsigned32BitValue() != 2)
+            LOG("Unsupported PDM channel count %u, using %u\n", channelsNumber->unsigned32BitValue(), captureChannels);
+    }
+    frameSize = captureChannels * SAMPLE_WIDTH / 8;
+    ringFrames = audioDevice->dmaBufferSize / frameSize;
+
+    if (spacingNumber && angleNumber) {
+        double angle = (SInt32)angleNumber->unsigned32BitValue() * 3.14159265358979323846 / 180.0;
+
+        step = spacingNumber->unsigned32BitValue() / 1000.0 * AMDMicrophoneResampler::sine(angle) / SPEED_OF_SOUND
+            * RESAMPLER_INPUT_RATE;
+    }
+    for (UInt32 channel = 0; channel < captureChannels; channel++)
+        delays[channel] = (float)((step < 0.0 ? (channel + 1.0 - captureChannels) : channel) * step);
+
+    dsp.resampler.setChannels(captureChannels, delays);
+    setProperty(PDM_CHANNELS_KEY, captureChannels, 32);
+}
+
+void AMDMicrophoneEngine::selectLatencyProfile()
+{
+    OSString* profileName = OSDynamicCast(OSString, audioDevice->getProperty(LATENCY_PROFILE_KEY));
+    UInt32 index = 0;
+
+    if (profileName) {
+        for (index = 0; index < sizeof(latencyProfiles) / sizeof(latencyProfiles[0]); index++) {
+            if (profileName->isEqualTo(latencyProfiles[index].name))
+                break;
+        }
+        if (index == sizeof(latencyProfiles) / sizeof(latencyProfiles[0])) {
+            LOG("Unknown latency profile %s, using %s\n", profileName->getCStringNoCopy(), latencyProfiles[0].name);
+            index = 0;
+        }
+    }
+
+    periodSize = latencyProfiles[index].periodFrames * frameSize;
+    setProperty(LATENCY_PROFILE_KEY, latencyProfiles[index].name);
+}
+
+void AMDMicrophoneEngine::updateBufferGeometry()
+{
+    // The family counts frames at the client rate, the hardware at 48 kHz.
+    setNumSampleFramesPerBuffer(dsp.resampler.toOutputFrames(ringFrames));
+    setInputSampleOffset(dsp.resampler.toOutputFrames(2 * periodSize / frameSize));
+    audioDevice->tap.restart(dsp.resampler.toOutputFrames(ringFrames));
+}
+
+// Reads the tunables from either a registry entry or a dictionary. Nothing is
+// applied unless every value present is valid; the result is published on
+// the engine either way.
+IOReturn AMDMicrophoneEngine::applyTunables(IORegistryEntry* source, OSDictionary* dictionary)
+{
+    AMDMicrophoneDSPParameters parameters = dsp.getParameters();
+    IOReturn result = kIOReturnSuccess;
+
+    for (UInt32 index = 0; index < sizeof(dspTunables) / sizeof(dspTunables[0]); index++) {
+        const char* key = dspTunables[index].key;
+        OSObject* object = source ? source->getProperty(key) : dictionary->getObject(key);
+        OSNumber* number = OSDynamicCast(OSNumber, object);
+        UInt32 value;
+
+        if (!object)
+            continue;
+
+        if (!number) {
+            result = kIOReturnBadArgument;
+            goto Done;
+        }
+
+        value = number->unsigned32BitValue();
+        if (value < dspTunables[index].minimum || value > dspTunables[index].maximum) {
+            result = kIOReturnBadArgument;
+            goto Done;
+        }
+
+        parameters.*dspTunables[index].member = value / 1000.0f;
+    }
+
+    dsp.setParameters(parameters);
+
+Done:
+    parameters = dsp.getParameters();
+    for (UInt32 index = 0; index < sizeof(dspTunables) / sizeof(dspTunables[0]); index++)
+        setProperty(dspTunables[index].key, (UInt32)(parameters.*dspTunables[index].member * 1000.0f + 0.5f), 32);
+    setInputSampleLatency(parameters.suppressionFloor < 1.0f ? SUPPRESSOR_LATENCY : 0);
+
+    return result;
+}
+
 bool AMDMicrophoneEngine::createControls()
 {
     bool result = false;
     IOAudioControl* control;
 
     control = IOAudioLevelControl::createVolumeControl(
-        volume,
+        MAX_VOLUME,
         0,
         MAX_VOLUME,
         (-22 << 16) + (32768),
@@ -74,8 +215,18 @@ IOAudioStream* AMDMicrophoneEngine::createNewAudioStream(
 
             audioStream->setSampleBuffer(sampleBuffer, sampleBufferSize);
             rate.fraction = 0;
-            rate.whole = SAMPLE_RATE;
-            audioStream->addAvailableFormat(&format, &rate, &rate);
+            for (UInt32 index = 0; index < sizeof(resamplerRates) / sizeof(resamplerRates[0]); index++) {
+                rate.whole = resamplerRates[index].rate;
+                for (UInt32 variant = 0; variant < sizeof(clientFormats) / sizeof(clientFormats[0]); variant++) {
+                    IOAudioStreamFormat clientFormat = format;
+
+                    clientFormat.fNumChannels = clientFormats[variant].numChannels;
+                    clientFormat.fBitDepth = clientFormats[variant].bitWidth;
+                    clientFormat.fBitWidth = clientFormats[variant].bitWidth;
+                    clientFormat.fIsMixable = clientFormats[variant].bitWidth == SAMPLE_WIDTH;
+                    audioStream->addAvailableFormat(&clientFormat, &rate, &rate);
+                }
+            }
             audioStream->setFormat(&format);
         }
     }
@@ -88,21 +239,35 @@ IOReturn AMDMicrophoneEngine::gainChangeHandler(
 )
 {
     AMDMicrophoneEngine* that = (AMDMicrophoneEngine*)target;
+    AMDMicrophoneDSPParameters parameters;
 
     if (!that)
         return kIOReturnBadArgument;
 
-    that->volume = newValue;
+    parameters = that->dsp.getParameters();
+    parameters.volumeGain = (float)newValue / MAX_VOLUME;
+    that->dsp.setParameters(parameters);
 
     return kIOReturnSuccess;
 }
 
+IOReturn AMDMicrophoneEngine::setPropertiesAction(
+    OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3
+)
+{
+    AMDMicrophoneEngine* that = (AMDMicrophoneEngine*)owner;
+
+    return that->applyTunables(NULL, (OSDictionary*)arg0);
+}
+
 bool AMDMicrophoneEngine::init(AMDMicrophoneDevice* device)
 {
     if (!super::init(NULL))
         return false;
 
     audioDevice = device;
+    dsp.stats = &device->stats;
+    dsp.tap = &device->tap;
 
     return true;
 }
@@ -126,14 +291,19 @@ bool AMDMicrophoneEngine::initHardware(IOService* provider)
     initialSampleRate.whole = SAMPLE_RATE;
     initialSampleRate.fraction = 0;
     setSampleRate(&initialSampleRate);
-    setNumSampleFramesPerBuffer(NUM_FRAMES);
-    setInputSampleOffset(2 * PERIOD_FRAMES);
+    selectCaptureChannels();
+    dsp.resampler.configure(SAMPLE_RATE);
+    dsp.fixedPoint = audioDevice->getProperty(FIXED_POINT_KEY) == kOSBooleanTrue;
+
+    selectLatencyProfile();
+    updateBufferGeometry();
+    applyTunables(audioDevice, NULL);
 
     if (!createControls())
         goto Done;
 
     audioStream = createNewAudioStream(
-        kIOAudioStreamDirectionInput, audioDevice->dmaDescriptor->getBytesNoCopy(), BUFFER_SIZE
+        kIOAudioStreamDirectionInput, audioDevice->dmaDescriptor->getBytesNoCopy(), audioDevice->dmaBufferSize
     );
     if (!audioStream)
         goto Done;
@@ -151,100 +321,187 @@ void AMDMicrophoneEngine::stop(IOService* provider)
     super::stop(provider);
 }
 
+IOReturn AMDMicrophoneEngine::setProperties(OSObject* properties)
+{
+    OSDictionary* dictionary = OSDynamicCast(OSDictionary, properties);
+
+    if (!dictionary || !commandGate)
+        return kIOReturnBadArgument;
+
+    // Runs on the work loop so it is serialized with the volume control.
+    return commandGate->runAction(setPropertiesAction, dictionary);
+}
+
 IOReturn AMDMicrophoneEngine::convertInputSamples(
     const void* sampleBuf, void* destBuf, UInt32 firstSampleFrame, UInt32 numSampleFrames,
     const IOAudioStreamFormat* streamFormat, IOAudioStream* audioStream
 )
 {
-    float* floatDestBuf;
-    SInt32* inputBuf32;
-    UInt32 firstSample = firstSampleFrame * streamFormat->fNumChannels;
-
-    floatDestBuf = (float*)destBuf;
-    inputBuf32 = &(((SInt32*)sampleBuf)[firstSample]);
-
-    while (numSampleFrames-- > 0) {
-        float sample;
-        float level;
-        float targetGain;
-
-        if (streamFormat->fNumChannels == 2) {
-            float left = (float)inputBuf32[0] / INT32_MAX;
-            float right = (float)inputBuf32[1] / INT32_MAX;
-
-            sample = (left + right) * 0.5f;
-            inputBuf32 += 2;
-        } else {
-            sample = (float)*inputBuf32++ / INT32_MAX;
-        }
+    return (this->*audioDevice->generation->convertInputSamples)(
+        sampleBuf, destBuf, firstSampleFrame, numSampleFrames, streamFormat, audioStream
+    );
+}
 
-        sample *= (float)volume / MAX_VOLUME;
+// The conversion for one ACP generation, which reads the DMA counter
+// directly while the clock model has not locked.
+template <typename Map>
+IOReturn AMDMicrophoneEngine::convertInputSamplesFor(
+    const void* sampleBuf, void* destBuf, UInt32 firstSampleFrame, UInt32 numSampleFrames,
+    const IOAudioStreamFormat* streamFormat, IOAudioStream* audioStream
+)
+{
+    AMDMicrophoneProbe probe(audioDevice->stats, kStatConvertInputSamples);
+    AMDMicrophoneTraceScope scope(audioDevice->trace, kTraceEntryConvert, firstSampleFrame);
+    UInt64 now, position;
+    bool lost;
+
+    clock_get_uptime(&now);
+    if (!clock.predict(now, &position))
+        position = AMDMicrophoneChipFor<Map>::from(audioDevice->acp)->getRelativeByteCount() / frameSize;
+
+    lost = audioDevice->xrun.read(
+        position, (UInt32)dsp.resampler.toInputFrames(firstSampleFrame),
+        (UInt32)dsp.resampler.toInputFrames(numSampleFrames)
+    );
+    if (audioDevice->tap.isAttached()) {
+        audioDevice->tap.feed(
+            firstSampleFrame, numSampleFrames, captureTime(now, position, firstSampleFrame), dsp.resampler.outputRate,
+            lost ? TAP_CHUNK_DISCONTINUITY : 0
+        );
+    }
 
-        level = sample >= 0.0f ? sample : -sample;
-        expanderEnvelope = expanderEnvelope * 0.990f + level * 0.010f;
-        if (expanderEnvelope >= INPUT_EXPANDER_THRESHOLD) {
-            targetGain = 1.0f;
-        } else {
-            targetGain = INPUT_EXPANDER_FLOOR
-                + (1.0f - INPUT_EXPANDER_FLOOR) * expanderEnvelope / INPUT_EXPANDER_THRESHOLD;
-        }
+    dsp.process(
+        (const SInt32*)sampleBuf, ringFrames, firstSampleFrame, destBuf, numSampleFrames, streamFormat->fNumChannels,
+        streamFormat->fBitWidth
+    );
 
-        if (targetGain > expanderGain)
-            expanderGain += (targetGain - expanderGain) * INPUT_EXPANDER_ATTACK;
-        else
-            expanderGain += (targetGain - expanderGain) * INPUT_EXPANDER_RELEASE;
+    scope.result = numSampleFrames;
+    return kIOReturnSuccess;
+}
 
-        sample *= expanderGain;
-        sample *= INPUT_SOFTWARE_GAIN;
+// Host time at which a client frame was captured: the most recent time the
+// DMA position passed its ring slot. Falls back to the current time while
+// the clock model has not locked.
+UInt64 AMDMicrophoneEngine::captureTime(UInt64 now, UInt64 position, UInt32 firstSampleFrame)
+{
+    UInt64 behind, time;
 
-        if (startupFadeFrame < STARTUP_FADE_FRAMES) {
-            sample *= (float)startupFadeFrame / STARTUP_FADE_FRAMES;
-            startupFadeFrame++;
-        }
+    behind = (position % ringFrames + ringFrames - dsp.resampler.toInputFrames(firstSampleFrame) % ringFrames)
+        % ringFrames;
+    if (behind > position || !clock.predictTime(position - behind, &time))
+        return now;
 
-        if (sample > 1.0f)
-            sample = 1.0f;
-        else if (sample < -1.0f)
-            sample = -1.0f;
+    return time;
+}
 
-        for (UInt32 channel = 0; channel < streamFormat->fNumChannels; channel++)
-            *floatDestBuf++ = sample;
-    }
+UInt32 AMDMicrophoneEngine::getCurrentSampleFrame()
+{
+    return (this->*audioDevice->generation->getCurrentSampleFrame)();
+}
 
-    return kIOReturnSuccess;
+template <typename Map>
+UInt32 AMDMicrophoneEngine::getCurrentSampleFrameFor()
+{
+    AMDMicrophoneProbe probe(audioDevice->stats, kStatGetCurrentSampleFrame);
+    AMDMicrophoneTraceScope scope(audioDevice->trace, kTraceEntryCurrentFrame);
+    UInt64 now, frame;
+
+    clock_get_uptime(&now);
+    if (!clock.predict(now, &frame))
+        frame = AMDMicrophoneChipFor<Map>::from(audioDevice->acp)->getRelativeByteCount() / frameSize;
+
+    return dsp.resampler.toOutputFrames((UInt32)(frame % ringFrames));
 }
 
-UInt32 AMDMicrophoneEngine::getCurrentSampleFrame()
+// The device binds these per generation, see AMDMicrophoneDevice.cpp.
+#define ACP_ENGINE_PATHS(Map)                                                                                    \
+    template IOReturn AMDMicrophoneEngine::convertInputSamplesFor<Map>(                                         \
+        const void*, void*, UInt32, UInt32, const IOAudioStreamFormat*, IOAudioStream*                          \
+    );                                                                                                           \
+    template UInt32 AMDMicrophoneEngine::getCurrentSampleFrameFor<Map>();
+
+ACP_SUPPORTED_MAPS(ACP_ENGINE_PATHS)
+
+// Called from the watermark interrupt with the DMA byte count and the host
+// time it was read at. Wraps are timestamped from the model, so they no
+// longer depend on an interrupt landing exactly on the buffer boundary.
+void AMDMicrophoneEngine::updateClock(UInt64 time, UInt64 byteCount)
 {
-    return (UInt32)(audioDevice->getRelativeByteCount() % BUFFER_SIZE) / FRAME_SIZE;
+    UInt64 frame = byteCount / frameSize;
+
+    clock.update(time, frame);
+    audioDevice->xrun.interrupt(frame);
+
+    if (awaitingFirstPeriod) {
+        awaitingFirstPeriod = false;
+        setProperty("FirstPeriodMicroseconds", microsecondsSince(startTime), 32);
+    }
+
+    while (frame >= nextWrapFrame) {
+        AbsoluteTime wrapTime = clock.timeAt(nextWrapFrame);
+
+        if (wrapTime <= lastWrapTime)
+            wrapTime = lastWrapTime + 1;
+        lastWrapTime = wrapTime;
+        takeTimeStamp(true, &wrapTime);
+        nextWrapFrame += ringFrames;
+    }
 }
 
 IOReturn AMDMicrophoneEngine::performAudioEngineStart()
 {
-    takeTimeStamp(false);
-    startupFadeFrame = 0;
-    expanderEnvelope = 0.0f;
-    expanderGain = INPUT_EXPANDER_FLOOR;
+    AMDMicrophoneChipStatus status;
+    UInt64 ticksPerSecond;
 
-    audioDevice->clearDMABuffer();
-    audioDevice->initRingBuffer(ACP_MEM_WINDOW_START, BUFFER_SIZE, PERIOD_SIZE);
-    audioDevice->writel(0x0, ACP_WOV_PDM_NO_OF_CHANNELS);
-    audioDevice->writel(ACP_PDM_DECIMATION_FACTOR, ACP_WOV_PDM_DECIMATION_FACTOR);
+    clock_get_uptime(&startTime);
+    nanoseconds_to_absolutetime(1000000000ULL, &ticksPerSecond);
+    clock.configure(ticksPerSecond, SAMPLE_RATE, periodSize / frameSize);
+    nextWrapFrame = ringFrames;
+    lastWrapTime = startTime;
+    audioDevice->xrun.configure(ringFrames, periodSize / frameSize);
+
+    cycleCounts = audioDevice->generation->chip->status(audioDevice->acp).counts;
+
+    IOReturn ret = audioDevice->wake();
+    if (ret != kIOReturnSuccess)
+        return ret;
+    audioDevice->stopListening();
+
+    takeTimeStamp(false, &lastWrapTime);
+    dsp.reset();
+    audioDevice->tap.restart(dsp.resampler.toOutputFrames(ringFrames));
 
-    IOReturn ret = audioDevice->startDMA();
+    audioDevice->clearDMABuffer();
+    ret = audioDevice->startCapture(periodSize, captureChannels);
     if (ret != kIOReturnSuccess)
         return ret;
 
-    IODelay(100);
-    audioDevice->enableInterrupt();
+    awaitingFirstPeriod = true;
+
+    // Start-path timing, readable with ioreg. FirstPeriodMicroseconds follows
+    // from the first watermark interrupt.
+    setProperty("StartupMicroseconds", microsecondsSince(startTime), 32);
+    status = audioDevice->generation->chip->status(audioDevice->acp);
+    setProperty("DMAStartPolls", status.lastPollCount, 32);
+    setProperty("DMAStartWaitMicroseconds", status.lastPollMicroseconds, 32);
 
     return kIOReturnSuccess;
 }
 
 IOReturn AMDMicrophoneEngine::performAudioEngineStop()
 {
-    audioDevice->disableInterrupt();
-    audioDevice->stopDMA();
+    OSDictionary* mmio;
+
+    audioDevice->stopCapture();
+    if (!audioDevice->startListening())
+        audioDevice->scheduleIdlePowerOff();
+
+    // Register traffic of the start/stop cycle, against the shadow.
+    mmio = audioDevice->copyMMIOCounts(cycleCounts);
+    if (mmio) {
+        setProperty(MMIO_CYCLE_KEY, mmio);
+        mmio->release();
+    }
 
     return kIOReturnSuccess;
 }
@@ -255,16 +512,29 @@ IOReturn AMDMicrophoneEngine::performFormatChange(
 {
     IOReturn result = kIOReturnSuccess;
 
+    if (newFormat) {
+        UInt32 index;
+
+        for (index = 0; index < sizeof(clientFormats) / sizeof(clientFormats[0]); index++) {
+            if (clientFormats[index].numChannels == newFormat->fNumChannels
+                && clientFormats[index].bitWidth == newFormat->fBitWidth)
+                break;
+        }
+        if (index == sizeof(clientFormats) / sizeof(clientFormats[0])) {
+            result = kIOReturnUnsupported;
+            goto Done;
+        }
+    }
+
     if (newSampleRate) {
-        switch (newSampleRate->whole) {
-        case SAMPLE_RATE:
-            result = kIOReturnSuccess;
-            break;
-        default:
+        if (newSampleRate->fraction != 0 || !dsp.resampler.configure(newSampleRate->whole)) {
             result = kIOReturnUnsupported;
-            break;
+            goto Done;
         }
+
+        updateBufferGeometry();
     }
 
+Done:
     return result;
 }
@@ -8,38 +8,75 @@
 #ifndef AMDMicrophoneEngine_hpp
 #define AMDMicrophoneEngine_hpp
 
+#include "AMDMicrophoneClock.hpp"
+#include "AMDMicrophoneDSP.hpp"
+#include "AMDMicrophoneShadow.hpp"
+
 #include <IOKit/audio/IOAudioEngine.h>
 
-#define NUM_PERIODS 4
-#define PERIOD_SIZE 8192
+// 7680 frames (160 ms) is a multiple of 480, so every rate offered by the
+// resampler maps the ring onto a whole number of client frames.
+#define NUM_PERIODS 8
+#define PERIOD_SIZE 7680
 #define BUFFER_SIZE (PERIOD_SIZE * NUM_PERIODS)
 
-#define SAMPLE_RATE  48000
+// DMA ring size in bytes, a multiple of BUFFER_SIZE so every profile and
+// channel count still divides it into whole periods. A larger ring gives
+// more headroom against late reads.
+#define DMA_BUFFER_SIZE_KEY "DMABufferSize"
+
+#define LATENCY_PROFILE_KEY "LatencyProfile"
+
+// Microphone array geometry: PDM channel count (2 or 4), spacing between
+// adjacent microphones in millimetres and steering angle in degrees from
+// broadside. Spacing 0 gives a plain average of the channels.
+#define PDM_CHANNELS_KEY "PDMChannels"
+#define MIC_SPACING_KEY  "MicSpacing"
+#define BEAM_ANGLE_KEY   "BeamAngle"
+#define SPEED_OF_SOUND   343.0
+
+// Boolean; runs the conversion in Q31 fixed point where it can.
+#define FIXED_POINT_KEY "FixedPointPipeline"
+
 #define NUM_CHANNELS 2
 #define SAMPLE_DEPTH 32
 #define SAMPLE_WIDTH 32
 #define FRAME_SIZE   (NUM_CHANNELS * SAMPLE_WIDTH / 8)
 #define PERIOD_FRAMES (PERIOD_SIZE / FRAME_SIZE)
 #define NUM_FRAMES   (BUFFER_SIZE / FRAME_SIZE)
-#define MAX_VOLUME   100
-#define INPUT_SOFTWARE_GAIN 3.0f
-#define INPUT_EXPANDER_THRESHOLD 0.018f
-#define INPUT_EXPANDER_FLOOR 0.18f
-#define INPUT_EXPANDER_ATTACK 0.05f
-#define INPUT_EXPANDER_RELEASE 0.001f
-#define STARTUP_FADE_FRAMES (SAMPLE_RATE / 2)
 
 class AMDMicrophoneDevice;
 
 class AMDMicrophoneEngine : public IOAudioEngine {
     OSDeclareDefaultStructors(AMDMicrophoneEngine);
 
+    friend class AMDMicrophoneDevice;
+
     AMDMicrophoneDevice* audioDevice;
-    UInt32 volume = MAX_VOLUME;
-    UInt32 startupFadeFrame = STARTUP_FADE_FRAMES;
-    float expanderEnvelope = 0.0f;
-    float expanderGain = 1.0f;
+    AMDMicrophoneDSP dsp;
+    AMDMicrophoneClock clock;
+    UInt32 captureChannels = NUM_CHANNELS;
+    UInt32 frameSize = FRAME_SIZE;
+    UInt32 ringFrames = NUM_FRAMES;
+    UInt32 periodSize = PERIOD_SIZE;
+    UInt64 nextWrapFrame = NUM_FRAMES;
+    AbsoluteTime lastWrapTime = 0;
+    AbsoluteTime startTime = 0;
+    bool awaitingFirstPeriod = false;
+    AMDMicrophoneMMIOCounts cycleCounts = {};
 
+    void selectCaptureChannels();
+    void selectLatencyProfile();
+    void updateBufferGeometry();
+    UInt64 captureTime(UInt64 now, UInt64 position, UInt32 firstSampleFrame);
+    template <typename Map>
+    IOReturn convertInputSamplesFor(
+        const void* sampleBuf, void* destBuf, UInt32 firstSampleFrame, UInt32 numSampleFrames,
+        const IOAudioStreamFormat* streamFormat, IOAudioStream* audioStream
+    );
+    template <typename Map>
+    UInt32 getCurrentSampleFrameFor();
+    IOReturn applyTunables(IORegistryEntry* source, OSDictionary* dictionary);
     bool createControls();
     IOAudioStream* createNewAudioStream(
         IOAudioStreamDirection direction, void* sampleBuffer, UInt32 sampleBufferSize
@@ -47,6 +84,7 @@ class AMDMicrophoneEngine : public IOAudioEngine {
     static IOReturn gainChangeHandler(
         IOService* target, IOAudioControl* gainControl, SInt32 oldValue, SInt32 newValue
     );
+    static IOReturn setPropertiesAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3);
 
 public:
     bool init(AMDMicrophoneDevice* device);
@@ -54,6 +92,10 @@ public:
 
     bool initHardware(IOService* provider) override;
     void stop(IOService* provider) override;
+    IOReturn setProperties(OSObject* properties) override;
+
+    void updateClock(UInt64 time, UInt64 byteCount);
+    UInt32 getCaptureChannels() const { return captureChannels; }
 
     IOReturn convertInputSamples(
         const void* sampleBuf, void* destBuf, UInt32 firstSampleFrame, UInt32 numSampleFrames,
@@ -0,0 +1,243 @@
+//
+//  AMDMicrophoneFFT.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneFFT_hpp
+#define AMDMicrophoneFFT_hpp
+
+#include "AMDMicrophoneResampler.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#include <emmintrin.h>
+
+// Real transform length. The spectrum has FFT_BINS bins, stored in arrays of
+// FFT_PADDED floats so the per-bin loops can run in whole vectors.
+#define FFT_SIZE   256
+#define FFT_HALF   (FFT_SIZE / 2)
+#define FFT_BINS   (FFT_HALF + 1)
+#define FFT_PADDED (FFT_HALF + 4)
+
+// Real FFT of FFT_SIZE samples, computed as a complex FFT of half the length
+// on the even/odd samples followed by a split pass. The complex transform is
+// radix-2 decimation in time with SSE2 butterflies on split real and
+// imaginary arrays; the first two stages are fused into one radix-4 pass on
+// transposed vectors. All twiddles are built by configure(), so forward()
+// and inverse() only touch preallocated members.
+class AMDMicrophoneFFT {
+    UInt16 bitReverse[FFT_HALF];
+    // Twiddles of the stage with half-span s at [s + j], for s >= 4.
+    float stageCos[FFT_HALF];
+    float stageSin[FFT_HALF];
+    // e^(-2 pi i k / FFT_SIZE) for the split pass.
+    float splitCos[FFT_HALF];
+    float splitSin[FFT_HALF];
+    float workReal[FFT_PADDED];
+    float workImag[FFT_PADDED];
+
+    void transform();
+
+public:
+    void configure();
+    void forward(const float* input, float* real, float* imag);
+    void inverse(const float* real, const float* imag, float* output);
+};
+
+inline void AMDMicrophoneFFT::configure()
+{
+    const double pi = 3.14159265358979323846;
+    UInt32 bits = 0;
+
+    while ((1U << bits) < FFT_HALF)
+        bits++;
+
+    for (UInt32 index = 0; index < FFT_HALF; index++) {
+        UInt32 reversed = 0;
+
+        for (UInt32 bit = 0; bit < bits; bit++) {
+            if (index & (1U << bit))
+                reversed |= 1U << (bits - 1 - bit);
+        }
+        bitReverse[index] = (UInt16)reversed;
+
+        splitCos[index] = (float)AMDMicrophoneResampler::sine(2.0 * pi * index / FFT_SIZE + pi / 2.0);
+        splitSin[index] = (float)-AMDMicrophoneResampler::sine(2.0 * pi * index / FFT_SIZE);
+    }
+
+    for (UInt32 span = 4; span < FFT_HALF; span *= 2) {
+        for (UInt32 j = 0; j < span; j++) {
+            stageCos[span + j] = (float)AMDMicrophoneResampler::sine(pi * j / span + pi / 2.0);
+            stageSin[span + j] = (float)-AMDMicrophoneResampler::sine(pi * j / span);
+        }
+    }
+}
+
+// Forward complex FFT of workReal/workImag, which must hold the input in
+// bit-reversed order.
+inline void AMDMicrophoneFFT::transform()
+{
+    // Spans 1 and 2: a radix-4 butterfly per group of four. After the
+    // transpose each vector holds the same element of four groups.
+    for (UInt32 group = 0; group < FFT_HALF; group += 16) {
+        __m128 r0 = _mm_loadu_ps(&workReal[group]);
+        __m128 r1 = _mm_loadu_ps(&workReal[group + 4]);
+        __m128 r2 = _mm_loadu_ps(&workReal[group + 8]);
+        __m128 r3 = _mm_loadu_ps(&workReal[group + 12]);
+        __m128 i0 = _mm_loadu_ps(&workImag[group]);
+        __m128 i1 = _mm_loadu_ps(&workImag[group + 4]);
+        __m128 i2 = _mm_loadu_ps(&workImag[group + 8]);
+        __m128 i3 = _mm_loadu_ps(&workImag[group + 12]);
+        __m128 ar0, ar1, ar2, ar3, ai0, ai1, ai2, ai3;
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+
+        ar0 = _mm_add_ps(r0, r1);
+        ai0 = _mm_add_ps(i0, i1);
+        ar1 = _mm_sub_ps(r0, r1);
+        ai1 = _mm_sub_ps(i0, i1);
+        ar2 = _mm_add_ps(r2, r3);
+        ai2 = _mm_add_ps(i2, i3);
+        ar3 = _mm_sub_ps(r2, r3);
+        ai3 = _mm_sub_ps(i2, i3);
+
+        // The span-2 twiddle for the odd element is -i.
+        r0 = _mm_add_ps(ar0, ar2);
+        i0 = _mm_add_ps(ai0, ai2);
+        r2 = _mm_sub_ps(ar0, ar2);
+        i2 = _mm_sub_ps(ai0, ai2);
+        r1 = _mm_add_ps(ar1, ai3);
+        i1 = _mm_sub_ps(ai1, ar3);
+        r3 = _mm_sub_ps(ar1, ai3);
+        i3 = _mm_add_ps(ai1, ar3);
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+        _mm_storeu_ps(&workReal[group], r0);
+        _mm_storeu_ps(&workReal[group + 4], r1);
+        _mm_storeu_ps(&workReal[group + 8], r2);
+        _mm_storeu_ps(&workReal[group + 12], r3);
+        _mm_storeu_ps(&workImag[group], i0);
+        _mm_storeu_ps(&workImag[group + 4], i1);
+        _mm_storeu_ps(&workImag[group + 8], i2);
+        _mm_storeu_ps(&workImag[group + 12], i3);
+    }
+
+    for (UInt32 span = 4; span < FFT_HALF; span *= 2) {
+        for (UInt32 group = 0; group < FFT_HALF; group += 2 * span) {
+            float* topReal = &workReal[group];
+            float* topImag = &workImag[group];
+            float* bottomReal = &workReal[group + span];
+            float* bottomImag = &workImag[group + span];
+
+            for (UInt32 j = 0; j < span; j += 4) {
+                __m128 wr = _mm_loadu_ps(&stageCos[span + j]);
+                __m128 wi = _mm_loadu_ps(&stageSin[span + j]);
+                __m128 br = _mm_loadu_ps(&bottomReal[j]);
+                __m128 bi = _mm_loadu_ps(&bottomImag[j]);
+                __m128 ar = _mm_loadu_ps(&topReal[j]);
+                __m128 ai = _mm_loadu_ps(&topImag[j]);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+
+                _mm_storeu_ps(&topReal[j], _mm_add_ps(ar, tr));
+                _mm_storeu_ps(&topImag[j], _mm_add_ps(ai, ti));
+                _mm_storeu_ps(&bottomReal[j], _mm_sub_ps(ar, tr));
+                _mm_storeu_ps(&bottomImag[j], _mm_sub_ps(ai, ti));
+            }
+        }
+    }
+}
+
+// Four lanes of a[base - 3 .. base] in reverse order, for the k / N/2 - k
+// pairing of the split passes.
+static inline __m128 fftLoadReversed(const float* a, UInt32 base)
+{
+    return _mm_shuffle_ps(_mm_loadu_ps(&a[base - 3]), _mm_loadu_ps(&a[base - 3]), _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// input holds FFT_SIZE samples. real and imag receive bins 0 to FFT_HALF
+// and must have room for FFT_PADDED floats.
+inline void AMDMicrophoneFFT::forward(const float* input, float* real, float* imag)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (UInt32 index = 0; index < FFT_HALF; index++) {
+        workReal[bitReverse[index]] = input[2 * index];
+        workImag[bitReverse[index]] = input[2 * index + 1];
+    }
+    transform();
+    workReal[FFT_HALF] = workReal[0];
+    workImag[FFT_HALF] = workImag[0];
+
+    // With Z the transform of the packed pairs, the even and odd spectra are
+    // E = (Z[k] + Z*[M - k]) / 2 and O = (Z[k] - Z*[M - k]) / 2i, and
+    // X[k] = E + W^k O.
+    for (UInt32 k = 0; k < FFT_HALF; k += 4) {
+        __m128 zr = _mm_loadu_ps(&workReal[k]);
+        __m128 zi = _mm_loadu_ps(&workImag[k]);
+        __m128 yr = fftLoadReversed(workReal, FFT_HALF - k);
+        __m128 yi = fftLoadReversed(workImag, FFT_HALF - k);
+        __m128 wr = _mm_loadu_ps(&splitCos[k]);
+        __m128 wi = _mm_loadu_ps(&splitSin[k]);
+        __m128 er = _mm_mul_ps(_mm_add_ps(zr, yr), half);
+        __m128 ei = _mm_mul_ps(_mm_sub_ps(zi, yi), half);
+        __m128 or_ = _mm_mul_ps(_mm_add_ps(zi, yi), half);
+        __m128 oi = _mm_mul_ps(_mm_sub_ps(yr, zr), half);
+
+        _mm_storeu_ps(&real[k], _mm_add_ps(er, _mm_sub_ps(_mm_mul_ps(wr, or_), _mm_mul_ps(wi, oi))));
+        _mm_storeu_ps(&imag[k], _mm_add_ps(ei, _mm_add_ps(_mm_mul_ps(wr, oi), _mm_mul_ps(wi, or_))));
+    }
+    real[FFT_HALF] = workReal[0] - workImag[0];
+    imag[FFT_HALF] = 0.0f;
+    for (UInt32 k = FFT_BINS; k < FFT_PADDED; k++) {
+        real[k] = 0.0f;
+        imag[k] = 0.0f;
+    }
+}
+
+// Inverse of forward(), including the 1 / FFT_SIZE scale. Only bins 0 to
+// FFT_HALF are read; the signal is assumed real.
+inline void AMDMicrophoneFFT::inverse(const float* real, const float* imag, float* output)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / FFT_SIZE);
+
+    // Rebuild Z from the Hermitian half spectrum as E + iO, with
+    // E = X[k] + X*[M - k] and O = (X[k] - X*[M - k]) W^-k, scaled by two.
+    // The complex inverse is done as a forward transform of the conjugate,
+    // so Z is conjugated on the way in and the 1 / N scale is left for the
+    // end. output is used as scratch before the bit-reversed gather.
+    for (UInt32 k = 0; k < FFT_HALF; k += 4) {
+        __m128 xr = _mm_loadu_ps(&real[k]);
+        __m128 xi = _mm_loadu_ps(&imag[k]);
+        __m128 yr = fftLoadReversed(real, FFT_HALF - k);
+        __m128 yi = fftLoadReversed(imag, FFT_HALF - k);
+        __m128 wr = _mm_loadu_ps(&splitCos[k]);
+        __m128 wi = _mm_loadu_ps(&splitSin[k]);
+        __m128 dr = _mm_sub_ps(xr, yr);
+        __m128 di = _mm_add_ps(xi, yi);
+        __m128 or_ = _mm_add_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi));
+        __m128 oi = _mm_sub_ps(_mm_mul_ps(di, wr), _mm_mul_ps(dr, wi));
+
+        _mm_storeu_ps(&output[k], _mm_sub_ps(_mm_add_ps(xr, yr), oi));
+        _mm_storeu_ps(&output[FFT_HALF + k], _mm_sub_ps(_mm_sub_ps(yi, xi), or_));
+    }
+    for (UInt32 index = 0; index < FFT_HALF; index++) {
+        workReal[bitReverse[index]] = output[index];
+        workImag[bitReverse[index]] = output[FFT_HALF + index];
+    }
+    transform();
+
+    // Conjugate back and unpack into even and odd samples.
+    for (UInt32 index = 0; index < FFT_HALF; index += 4) {
+        __m128 even = _mm_mul_ps(_mm_loadu_ps(&workReal[index]), scale);
+        __m128 odd = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(_mm_loadu_ps(&workImag[index]), scale));
+
+        _mm_storeu_ps(&output[2 * index], _mm_unpacklo_ps(even, odd));
+        _mm_storeu_ps(&output[2 * index + 4], _mm_unpackhi_ps(even, odd));
+    }
+}
+
+#endif /* AMDMicrophoneFFT_hpp */
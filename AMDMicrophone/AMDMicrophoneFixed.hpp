@@ -0,0 +1,315 @@
+//
+//  AMDMicrophoneFixed.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneFixed_hpp
+#define AMDMicrophoneFixed_hpp
+
+#include "AMDMicrophoneHighpass.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#include <emmintrin.h>
+
+#define FIXED_Q15_ONE     32767
+#define FIXED_Q31_MAX     0x7FFFFFFF
+#define FIXED_Q31_MIN     (-FIXED_Q31_MAX - 1)
+#define FIXED_SLOPE_BITS  24
+#define FIXED_FILTER_BITS 30
+#define FIXED_RAMP_BITS   16
+
+// Integer building blocks of the fixed-point conversion path. Samples are
+// Q31, gains Q15 in [0, FIXED_Q15_ONE]. Every vector helper has a scalar twin
+// that gives the same result bit for bit, so block tails and the vector body
+// agree and the output does not depend on how calls are split.
+
+static inline SInt32 fixedQ15(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return FIXED_Q15_ONE;
+    return (SInt32)(value * FIXED_Q15_ONE + 0.5f);
+}
+
+static inline SInt32 fixedQ31(double value)
+{
+    if (value <= -1.0)
+        return FIXED_Q31_MIN;
+    if (value >= 1.0)
+        return FIXED_Q31_MAX;
+    return (SInt32)(value * 2147483648.0);
+}
+
+// (a * gain) >> 15 with bit 0 of a dropped, so that both partial products
+// fit pmaddwd: the high half of a times the gain and the low 15 bits of its
+// low half times the gain. Cannot overflow for gains up to FIXED_Q15_ONE.
+static inline SInt32 fixedScale(SInt32 a, SInt32 gain)
+{
+    SInt32 high = (a >> 16) * gain;
+    SInt32 low = ((a & 0xFFFF) >> 1) * gain;
+
+    return high * 2 + (low >> 14);
+}
+
+static inline __m128i fixedScale(__m128i a, __m128i gain)
+{
+    __m128i packed = _mm_or_si128(
+        _mm_and_si128(a, _mm_set1_epi32((int)0xFFFF0000)), _mm_srli_epi32(_mm_slli_epi32(a, 16), 17)
+    );
+    __m128i high = _mm_madd_epi16(packed, _mm_slli_epi32(gain, 16));
+    __m128i low = _mm_madd_epi16(packed, gain);
+
+    return _mm_add_epi32(_mm_slli_epi32(high, 1), _mm_srai_epi32(low, 14));
+}
+
+// a << shift, saturated to Q31.
+static inline SInt32 fixedShift(SInt32 a, UInt32 shift)
+{
+    SInt32 limit = FIXED_Q31_MAX >> shift;
+
+    if (a > limit)
+        return FIXED_Q31_MAX;
+    if (a < -limit - 1)
+        return FIXED_Q31_MIN;
+    return (SInt32)((UInt32)a << shift);
+}
+
+static inline __m128i fixedShift(__m128i a, UInt32 shift)
+{
+    __m128i upper = _mm_set1_epi32(FIXED_Q31_MAX >> shift);
+    __m128i lower = _mm_set1_epi32(-(FIXED_Q31_MAX >> shift) - 1);
+    __m128i above = _mm_cmpgt_epi32(a, upper);
+    __m128i below = _mm_cmplt_epi32(a, lower);
+    __m128i shifted = _mm_sll_epi32(a, _mm_cvtsi32_si128((int)shift));
+
+    shifted = _mm_or_si128(_mm_and_si128(above, _mm_set1_epi32(FIXED_Q31_MAX)), _mm_andnot_si128(above, shifted));
+    return _mm_or_si128(_mm_and_si128(below, _mm_set1_epi32(FIXED_Q31_MIN)), _mm_andnot_si128(below, shifted));
+}
+
+// Linear Q15 gain ramp across a block, kept in Q15.16 so it advances by a
+// constant integer step per frame.
+struct AMDMicrophoneFixedRamp {
+    SInt32 start;
+    SInt32 step;
+
+    AMDMicrophoneFixedRamp(SInt32 from, SInt32 to, UInt32 numFrames)
+        : start(from << FIXED_RAMP_BITS)
+        , step((SInt32)(((SInt64)(to - from) << FIXED_RAMP_BITS) / (SInt32)numFrames))
+    {
+    }
+
+    SInt32 at(UInt32 frame) const { return (start + step * (SInt32)frame) >> FIXED_RAMP_BITS; }
+
+    __m128i at4(UInt32 frame) const
+    {
+        return _mm_srai_epi32(
+            _mm_add_epi32(_mm_set1_epi32(start + step * (SInt32)frame), _mm_set_epi32(3 * step, 2 * step, step, 0)),
+            FIXED_RAMP_BITS
+        );
+    }
+};
+
+// State of the fixed-point path: a direct form I high-pass with Q2.30
+// coefficients, the expander in Q31 and the software gain split into a Q15
+// mantissa and a saturating shift. The recursive stages are scalar with
+// 64-bit products; the rest is SSE2.
+class AMDMicrophoneFixed {
+    struct Section {
+        SInt32 b0, b1, b2, a1, a2;
+        SInt32 x1, x2, y1, y2;
+    };
+
+    Section sections[HIGHPASS_SECTIONS];
+    bool highpassActive = false;
+
+    SInt32 envelopeDecay = fixedQ31(0.990);
+    SInt32 envelopeRise = fixedQ31(0.010);
+    SInt32 expanderThreshold = 0;
+    SInt32 expanderFloor = 0;
+    SInt64 expanderSlope = 0;
+    SInt32 expanderAttack = 0;
+    SInt32 expanderRelease = 0;
+
+public:
+    SInt32 envelope = 0;
+    SInt32 gain = FIXED_Q31_MAX;
+    SInt32 softwareMantissa = FIXED_Q15_ONE;
+    UInt32 softwareShift = 0;
+
+    void setHighpass(UInt32 sampleRate, float cutoff);
+    void setExpander(float threshold, float floor, float attack, float release);
+    void setSoftwareGain(float softwareGain);
+    void reset(float initialGain);
+
+    void decode(const SInt32* input, SInt32* block, UInt32 numFrames, UInt32 numChannels, const AMDMicrophoneFixedRamp& ramp);
+    void highpass(SInt32* block, UInt32 numFrames);
+    void expand(SInt32* block, UInt32 numFrames);
+};
+
+inline void AMDMicrophoneFixed::setHighpass(UInt32 sampleRate, float cutoff)
+{
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        Section* section = &sections[index];
+        double coefficients[5];
+
+        highpassActive = AMDMicrophoneHighpass::design(sampleRate, cutoff, index, coefficients);
+        if (!highpassActive)
+            return;
+
+        section->b0 = (SInt32)(coefficients[0] * (1 << FIXED_FILTER_BITS));
+        section->b1 = (SInt32)(coefficients[1] * (1 << FIXED_FILTER_BITS));
+        section->b2 = (SInt32)(coefficients[2] * (1 << FIXED_FILTER_BITS));
+        section->a1 = (SInt32)(coefficients[3] * (1 << FIXED_FILTER_BITS));
+        section->a2 = (SInt32)(coefficients[4] * (1 << FIXED_FILTER_BITS));
+        section->x1 = section->x2 = section->y1 = section->y2 = 0;
+    }
+}
+
+inline void AMDMicrophoneFixed::setExpander(float threshold, float floor, float attack, float release)
+{
+    expanderThreshold = fixedQ31(threshold);
+    expanderFloor = fixedQ31(floor);
+    expanderSlope = (SInt64)((1.0 - floor) / threshold * (1 << FIXED_SLOPE_BITS));
+    expanderAttack = fixedQ31(attack);
+    expanderRelease = fixedQ31(release);
+}
+
+// Gains above one become a mantissa below one and a left shift.
+inline void AMDMicrophoneFixed::setSoftwareGain(float softwareGain)
+{
+    softwareShift = 0;
+    while (softwareGain > 1.0f) {
+        softwareGain *= 0.5f;
+        softwareShift++;
+    }
+    softwareMantissa = fixedQ15(softwareGain);
+}
+
+inline void AMDMicrophoneFixed::reset(float initialGain)
+{
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++)
+        sections[index].x1 = sections[index].x2 = sections[index].y1 = sections[index].y2 = 0;
+    envelope = 0;
+    gain = fixedQ31(initialGain);
+}
+
+// Mono Q31 mix of the ring with the volume ramp applied. Each channel is
+// shifted down before the sum so it cannot overflow.
+inline void AMDMicrophoneFixed::decode(
+    const SInt32* input, SInt32* block, UInt32 numFrames, UInt32 numChannels, const AMDMicrophoneFixedRamp& ramp
+)
+{
+    UInt32 frame = 0;
+
+    if (numChannels == 2) {
+        for (; frame + 4 <= numFrames; frame += 4) {
+            __m128 lo = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&input[frame * 2]));
+            __m128 hi = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&input[frame * 2 + 4]));
+            __m128i left = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i right = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i mono = _mm_add_epi32(_mm_srai_epi32(left, 1), _mm_srai_epi32(right, 1));
+
+            _mm_storeu_si128((__m128i*)&block[frame], fixedScale(mono, ramp.at4(frame)));
+        }
+        for (; frame < numFrames; frame++)
+            block[frame] = fixedScale((input[frame * 2] >> 1) + (input[frame * 2 + 1] >> 1), ramp.at(frame));
+    } else if (numChannels == 4) {
+        for (; frame + 4 <= numFrames; frame += 4) {
+            __m128i frame0 = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)&input[frame * 4]), 2);
+            __m128i frame1 = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)&input[frame * 4 + 4]), 2);
+            __m128i frame2 = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)&input[frame * 4 + 8]), 2);
+            __m128i frame3 = _mm_srai_epi32(_mm_loadu_si128((const __m128i*)&input[frame * 4 + 12]), 2);
+            __m128i low01 = _mm_unpacklo_epi32(frame0, frame1);
+            __m128i low23 = _mm_unpacklo_epi32(frame2, frame3);
+            __m128i high01 = _mm_unpackhi_epi32(frame0, frame1);
+            __m128i high23 = _mm_unpackhi_epi32(frame2, frame3);
+            __m128i mono = _mm_add_epi32(
+                _mm_add_epi32(_mm_unpacklo_epi64(low01, low23), _mm_unpackhi_epi64(low01, low23)),
+                _mm_add_epi32(_mm_unpacklo_epi64(high01, high23), _mm_unpackhi_epi64(high01, high23))
+            );
+
+            _mm_storeu_si128((__m128i*)&block[frame], fixedScale(mono, ramp.at4(frame)));
+        }
+        for (; frame < numFrames; frame++) {
+            SInt32 mono = ((input[frame * 4] >> 2) + (input[frame * 4 + 1] >> 2))
+                + ((input[frame * 4 + 2] >> 2) + (input[frame * 4 + 3] >> 2));
+
+            block[frame] = fixedScale(mono, ramp.at(frame));
+        }
+    } else {
+        for (; frame + 4 <= numFrames; frame += 4) {
+            __m128i mono = _mm_loadu_si128((const __m128i*)&input[frame]);
+
+            _mm_storeu_si128((__m128i*)&block[frame], fixedScale(mono, ramp.at4(frame)));
+        }
+        for (; frame < numFrames; frame++)
+            block[frame] = fixedScale(input[frame], ramp.at(frame));
+    }
+}
+
+inline void AMDMicrophoneFixed::highpass(SInt32* block, UInt32 numFrames)
+{
+    if (!highpassActive)
+        return;
+
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        Section* section = &sections[index];
+        SInt32 x1 = section->x1, x2 = section->x2, y1 = section->y1, y2 = section->y2;
+
+        for (UInt32 frame = 0; frame < numFrames; frame++) {
+            SInt32 x = block[frame];
+            SInt64 sum = (SInt64)section->b0 * x + (SInt64)section->b1 * x1 + (SInt64)section->b2 * x2
+                - (SInt64)section->a1 * y1 - (SInt64)section->a2 * y2 + (1LL << (FIXED_FILTER_BITS - 1));
+            SInt64 y = sum >> FIXED_FILTER_BITS;
+
+            if (y > FIXED_Q31_MAX)
+                y = FIXED_Q31_MAX;
+            else if (y < FIXED_Q31_MIN)
+                y = FIXED_Q31_MIN;
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = (SInt32)y;
+            block[frame] = (SInt32)y;
+        }
+
+        section->x1 = x1;
+        section->x2 = x2;
+        section->y1 = y1;
+        section->y2 = y2;
+    }
+}
+
+// Same envelope follower and gain smoother as the float expander, in Q31.
+inline void AMDMicrophoneFixed::expand(SInt32* block, UInt32 numFrames)
+{
+    SInt32 currentEnvelope = envelope;
+    SInt32 currentGain = gain;
+
+    for (UInt32 frame = 0; frame < numFrames; frame++) {
+        SInt32 sample = block[frame];
+        SInt32 level = sample >= 0 ? sample : (sample == FIXED_Q31_MIN ? FIXED_Q31_MAX : -sample);
+        SInt32 target;
+
+        currentEnvelope = (SInt32)(((SInt64)currentEnvelope * envelopeDecay + (SInt64)level * envelopeRise) >> 31);
+        if (currentEnvelope >= expanderThreshold) {
+            target = FIXED_Q31_MAX;
+        } else {
+            SInt64 value = expanderFloor + (((SInt64)currentEnvelope * expanderSlope) >> FIXED_SLOPE_BITS);
+
+            target = value > FIXED_Q31_MAX ? FIXED_Q31_MAX : (SInt32)value;
+        }
+
+        currentGain += (SInt32)(((SInt64)(target - currentGain) * (target > currentGain ? expanderAttack : expanderRelease)) >> 31);
+        block[frame] = (SInt32)(((SInt64)sample * currentGain) >> 31);
+    }
+
+    envelope = currentEnvelope;
+    gain = currentGain;
+}
+
+#endif /* AMDMicrophoneFixed_hpp */
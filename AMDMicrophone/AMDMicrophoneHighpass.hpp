@@ -0,0 +1,232 @@
+//
+//  AMDMicrophoneHighpass.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneHighpass_hpp
+#define AMDMicrophoneHighpass_hpp
+
+#include "AMDMicrophoneResampler.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#include <emmintrin.h>
+
+// Biquad sections in the cascade: a Butterworth high-pass of twice this order.
+#define HIGHPASS_SECTIONS 2
+
+// State values below this are flushed to zero after each block. A filter fed
+// silence then comes to rest instead of ringing down into subnormals.
+#define HIGHPASS_STATE_FLOOR 1e-20f
+
+// Butterworth high-pass that removes the PDM DC offset and rumble before the
+// level detectors see them. Each section is a transposed direct form II
+// biquad. Four frames at a time a section is a linear map from the four
+// inputs and its two state values to the four outputs and the next state, so
+// the kernel is a handful of broadcast multiply-adds per section with the
+// state held in one register across the block. The maps are built from the
+// scalar recursion by configure(), whenever the rate or cutoff changes.
+class AMDMicrophoneHighpass {
+    struct Section {
+        float b0, b1, b2, a1, a2;
+        // Response of the four outputs (lanes 0-3) and the next state (lanes
+        // 0-1) to each input frame and to each state value.
+        float outputFromInput[4][4];
+        float outputFromState[2][4];
+        float stateFromInput[4][4];
+        float stateFromState[2][4];
+        float state[4];
+    };
+
+    Section sections[HIGHPASS_SECTIONS];
+    bool active = false;
+
+    static void step(const Section& section, float input, float* state, float* output);
+
+public:
+    static bool design(UInt32 sampleRate, float cutoff, UInt32 index, double* coefficients);
+    void configure(UInt32 sampleRate, float cutoff);
+    void reset();
+    bool isActive() const { return active; }
+    bool isQuiet(float level) const;
+    void process(float* block, UInt32 numFrames);
+};
+
+inline void AMDMicrophoneHighpass::step(const Section& section, float input, float* state, float* output)
+{
+    float value = section.b0 * input + state[0];
+
+    state[0] = section.b1 * input - section.a1 * value + state[1];
+    state[1] = section.b2 * input - section.a2 * value;
+    *output = value;
+}
+
+// Coefficients b0, b1, b2, a1, a2 of section index, normalized to a0 = 1.
+// cutoff is in Hz; fails when it is 0 or above Nyquist.
+inline bool AMDMicrophoneHighpass::design(UInt32 sampleRate, float cutoff, UInt32 index, double* coefficients)
+{
+    const double pi = 3.14159265358979323846;
+    double omega = 2.0 * pi * cutoff / sampleRate;
+    double sine = AMDMicrophoneResampler::sine(omega);
+    double cosine = AMDMicrophoneResampler::sine(omega + pi / 2.0);
+    double q = 0.5 / AMDMicrophoneResampler::sine((2 * index + 1) * pi / (4 * HIGHPASS_SECTIONS));
+    double alpha = sine / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    if (cutoff <= 0.0f || cutoff >= sampleRate / 2)
+        return false;
+
+    coefficients[0] = (1.0 + cosine) / 2.0 / a0;
+    coefficients[1] = -(1.0 + cosine) / a0;
+    coefficients[2] = coefficients[0];
+    coefficients[3] = -2.0 * cosine / a0;
+    coefficients[4] = (1.0 - alpha) / a0;
+
+    return true;
+}
+
+inline void AMDMicrophoneHighpass::configure(UInt32 sampleRate, float cutoff)
+{
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        Section* section = &sections[index];
+        double coefficients[5];
+
+        active = design(sampleRate, cutoff, index, coefficients);
+        if (!active)
+            return;
+
+        section->b0 = (float)coefficients[0];
+        section->b1 = (float)coefficients[1];
+        section->b2 = (float)coefficients[2];
+        section->a1 = (float)coefficients[3];
+        section->a2 = (float)coefficients[4];
+
+        // Impulse responses of the four-step recursion, one unit input or
+        // unit state at a time.
+        for (UInt32 source = 0; source < 6; source++) {
+            float state[2] = { source == 4 ? 1.0f : 0.0f, source == 5 ? 1.0f : 0.0f };
+            float output[4];
+
+            for (UInt32 frame = 0; frame < 4; frame++)
+                step(*section, frame == source ? 1.0f : 0.0f, state, &output[frame]);
+
+            for (UInt32 lane = 0; lane < 4; lane++) {
+                float stateLane = lane < 2 ? state[lane] : 0.0f;
+
+                if (source < 4) {
+                    section->outputFromInput[source][lane] = output[lane];
+                    section->stateFromInput[source][lane] = stateLane;
+                } else {
+                    section->outputFromState[source - 4][lane] = output[lane];
+                    section->stateFromState[source - 4][lane] = stateLane;
+                }
+            }
+        }
+    }
+    reset();
+}
+
+inline void AMDMicrophoneHighpass::reset()
+{
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        for (UInt32 lane = 0; lane < 4; lane++)
+            sections[index].state[lane] = 0.0f;
+    }
+}
+
+// All sections advance together, four frames per step, so their state
+// recursions overlap instead of running one block-long chain per section.
+inline void AMDMicrophoneHighpass::process(float* block, UInt32 numFrames)
+{
+    __m128 state[HIGHPASS_SECTIONS];
+    UInt32 frame = 0;
+
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++)
+        state[index] = _mm_loadu_ps(sections[index].state);
+
+    for (; frame + 4 <= numFrames; frame += 4) {
+        __m128 value = _mm_loadu_ps(&block[frame]);
+
+        for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+            const Section* section = &sections[index];
+            __m128 x0 = _mm_shuffle_ps(value, value, _MM_SHUFFLE(0, 0, 0, 0));
+            __m128 x1 = _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1));
+            __m128 x2 = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 2, 2, 2));
+            __m128 x3 = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+            __m128 s0 = _mm_shuffle_ps(state[index], state[index], _MM_SHUFFLE(0, 0, 0, 0));
+            __m128 s1 = _mm_shuffle_ps(state[index], state[index], _MM_SHUFFLE(1, 1, 1, 1));
+            __m128 fromInput = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromInput[0]), x0),
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromInput[1]), x1)
+                ),
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromInput[2]), x2),
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromInput[3]), x3)
+                )
+            );
+            __m128 stateFromInput = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromInput[0]), x0),
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromInput[1]), x1)
+                ),
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromInput[2]), x2),
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromInput[3]), x3)
+                )
+            );
+
+            value = _mm_add_ps(
+                fromInput,
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromState[0]), s0),
+                    _mm_mul_ps(_mm_loadu_ps(section->outputFromState[1]), s1)
+                )
+            );
+            state[index] = _mm_add_ps(
+                stateFromInput,
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromState[0]), s0),
+                    _mm_mul_ps(_mm_loadu_ps(section->stateFromState[1]), s1)
+                )
+            );
+        }
+        _mm_storeu_ps(&block[frame], value);
+    }
+
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++)
+        _mm_storeu_ps(sections[index].state, state[index]);
+
+    for (; frame < numFrames; frame++) {
+        for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++)
+            step(sections[index], block[frame], sections[index].state, &block[frame]);
+    }
+
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        __m128 value = _mm_loadu_ps(sections[index].state);
+        __m128 magnitude = _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+
+        _mm_storeu_ps(
+            sections[index].state, _mm_andnot_ps(_mm_cmplt_ps(magnitude, _mm_set1_ps(HIGHPASS_STATE_FLOOR)), value)
+        );
+    }
+}
+
+// True when every state value is below level, so the filter's response to
+// further silence stays below it too.
+inline bool AMDMicrophoneHighpass::isQuiet(float level) const
+{
+    for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+        for (UInt32 lane = 0; lane < 2; lane++) {
+            float value = sections[index].state[lane];
+
+            if (value >= level || value <= -level)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* AMDMicrophoneHighpass_hpp */
@@ -0,0 +1,254 @@
+//
+//  AMDMicrophoneResampler.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneResampler_hpp
+#define AMDMicrophoneResampler_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+#include <emmintrin.h>
+
+#define RESAMPLER_INPUT_RATE   48000
+#define RESAMPLER_TAPS         32
+#define RESAMPLER_BEAM_TAPS    8
+#define RESAMPLER_MAX_TAPS     40
+#define RESAMPLER_MAX_PHASES   147
+#define RESAMPLER_MAX_CHANNELS 4
+#define RESAMPLER_MAX_DELAY    (RESAMPLER_MAX_TAPS - RESAMPLER_TAPS)
+
+// Rates offered to clients, as interpolation / decimation ratios of the
+// 48 kHz PDM stream. The ring buffer must hold a multiple of 480 frames so
+// that each of them maps it onto a whole number of output frames.
+static const struct {
+    UInt32 rate;
+    UInt32 interpolation;
+    UInt32 decimation;
+} resamplerRates[] = {
+    { 16000, 1, 3 },
+    { 44100, 147, 160 },
+    { 48000, 1, 1 },
+    { 96000, 2, 1 },
+};
+
+// Polyphase FIR that turns the interleaved int32 DMA ring into the mono
+// signal. Every channel gets its own filter, so one pass does the int32
+// scale, the delay-and-sum beamformer (a fractional delay per channel) and
+// the rate conversion; each output frame is a single dot product over all
+// channels of the window. At 48 kHz with no steering delays the filter is a
+// plain average and the DSP skips it in favour of its cheaper decode.
+//
+// With resampling each channel filter has RESAMPLER_TAPS taps and adds
+// RESAMPLER_TAPS / 2 input frames (0.33 ms) of delay; at 48 kHz the
+// beamformer uses RESAMPLER_BEAM_TAPS taps. Steering delays widen the filter
+// by up to RESAMPLER_MAX_DELAY frames.
+class AMDMicrophoneResampler {
+    UInt32 interpolation = 1;
+    UInt32 decimation = 1;
+    UInt32 decimationWhole = 1;
+    UInt32 decimationFraction = 0;
+    UInt32 channels = 2;
+    UInt32 taps = 0;
+    float delays[RESAMPLER_MAX_CHANNELS] = {};
+    bool steered = false;
+    float coefficients[RESAMPLER_MAX_PHASES][RESAMPLER_MAX_TAPS * RESAMPLER_MAX_CHANNELS];
+
+public:
+    UInt32 outputRate = RESAMPLER_INPUT_RATE;
+
+    static double sine(double x);
+
+    void setChannels(UInt32 numChannels, const float* channelDelays);
+    UInt32 getChannels() const { return channels; }
+    bool configure(UInt32 rate);
+    bool isActive() const { return interpolation != decimation || steered; }
+    UInt32 toOutputFrames(UInt32 inputFrames) const
+    {
+        return (UInt32)((UInt64)inputFrames * interpolation / decimation);
+    }
+    UInt64 toInputFrames(UInt64 outputFrames) const { return outputFrames * decimation / interpolation; }
+
+    void process(
+        const SInt32* ring, UInt32 ringFrames, UInt32 firstOutputFrame, float* block, UInt32 numFrames, float gain,
+        float gainStep
+    ) const;
+};
+
+inline double AMDMicrophoneResampler::sine(double x)
+{
+    // Only used while building the tables, where libm is not available in the
+    // kernel. Reduced to [-pi/2, pi/2], the series is accurate to 1e-9.
+    const double pi = 3.14159265358979323846;
+    double x2, term, result;
+
+    x -= 2.0 * pi * (double)(SInt64)(x / (2.0 * pi) + (x >= 0.0 ? 0.5 : -0.5));
+    if (x > pi / 2.0)
+        x = pi - x;
+    else if (x < -pi / 2.0)
+        x = -pi - x;
+
+    x2 = x * x;
+    term = x;
+    result = x;
+    for (int n = 1; n <= 6; n++) {
+        term *= -x2 / ((2 * n) * (2 * n + 1));
+        result += term;
+    }
+
+    return result;
+}
+
+// Delays are in input frames and are clamped to [0, RESAMPLER_MAX_DELAY].
+// Takes effect on the next configure().
+inline void AMDMicrophoneResampler::setChannels(UInt32 numChannels, const float* channelDelays)
+{
+    channels = numChannels;
+    steered = false;
+    for (UInt32 channel = 0; channel < channels; channel++) {
+        float delay = channelDelays ? channelDelays[channel] : 0.0f;
+
+        if (delay < 0.0f)
+            delay = 0.0f;
+        else if (delay > RESAMPLER_MAX_DELAY)
+            delay = RESAMPLER_MAX_DELAY;
+        delays[channel] = delay;
+        if (delay != 0.0f)
+            steered = true;
+    }
+}
+
+inline bool AMDMicrophoneResampler::configure(UInt32 rate)
+{
+    const double pi = 3.14159265358979323846;
+    UInt32 index, baseTaps, length;
+    double cutoff, maxDelay = 0.0;
+
+    for (index = 0; index < sizeof(resamplerRates) / sizeof(resamplerRates[0]); index++) {
+        if (resamplerRates[index].rate == rate)
+            break;
+    }
+    if (index == sizeof(resamplerRates) / sizeof(resamplerRates[0]))
+        return false;
+
+    interpolation = resamplerRates[index].interpolation;
+    decimation = resamplerRates[index].decimation;
+    decimationWhole = decimation / interpolation;
+    decimationFraction = decimation % interpolation;
+    outputRate = rate;
+
+    if (!isActive())
+        return true;
+
+    // Blackman-windowed sinc prototype at the interpolated rate, cut off at
+    // 90% of the lower of the two Nyquist frequencies and shifted by each
+    // channel's delay. Phase p uses taps p, p + L, p + 2L, ... and is stored
+    // oldest input frame first, with the channels interleaved like the ring.
+    // taps is kept a multiple of 4 for the vector loop.
+    for (UInt32 channel = 0; channel < channels; channel++) {
+        if (delays[channel] > maxDelay)
+            maxDelay = delays[channel];
+    }
+    baseTaps = interpolation == decimation ? RESAMPLER_BEAM_TAPS : RESAMPLER_TAPS;
+    taps = baseTaps + (UInt32)maxDelay;
+    if (maxDelay > (UInt32)maxDelay)
+        taps++;
+    taps = (taps + 3) & ~3U;
+    length = interpolation * baseTaps;
+    cutoff = 0.45 / (interpolation > decimation ? interpolation : decimation);
+
+    for (UInt32 phase = 0; phase < interpolation; phase++) {
+        for (UInt32 channel = 0; channel < channels; channel++) {
+            double shift = delays[channel] * interpolation;
+            double sum = 0.0;
+            float scale;
+
+            for (UInt32 tap = 0; tap < taps; tap++) {
+                double n = phase + tap * interpolation - shift;
+                double t = n - (length - 1) / 2.0;
+                double value = 0.0;
+
+                if (n >= 0.0 && n <= length - 1) {
+                    double sinc = t == 0.0 ? 2.0 * cutoff : sine(2.0 * pi * cutoff * t) / (pi * t);
+                    double window = 0.42 - 0.5 * sine(2.0 * pi * n / (length - 1) + pi / 2.0)
+                        + 0.08 * sine(4.0 * pi * n / (length - 1) + pi / 2.0);
+
+                    value = sinc * window;
+                }
+                coefficients[phase][(taps - 1 - tap) * channels + channel] = (float)value;
+                sum += value;
+            }
+
+            // Unity gain at DC for every phase, with the int32 scale and the
+            // channel average folded in.
+            scale = (float)(1.0 / (sum * channels * 2147483648.0));
+            for (UInt32 tap = 0; tap < taps; tap++)
+                coefficients[phase][tap * channels + channel] *= scale;
+        }
+    }
+
+    return true;
+}
+
+inline void AMDMicrophoneResampler::process(
+    const SInt32* ring, UInt32 ringFrames, UInt32 firstOutputFrame, float* block, UInt32 numFrames, float gain,
+    float gainStep
+) const
+{
+    SInt32 wrapped[RESAMPLER_MAX_TAPS * RESAMPLER_MAX_CHANNELS];
+    UInt32 windowSamples = taps * channels;
+    UInt64 position = (UInt64)firstOutputFrame * decimation;
+    UInt32 base = (UInt32)(position / interpolation);
+    UInt32 phase = (UInt32)(position % interpolation);
+
+    for (UInt32 frame = 0; frame < numFrames; frame++) {
+        const float* coeff = coefficients[phase];
+        const SInt32* window;
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+
+        if (base + 1 >= taps) {
+            window = &ring[(base + 1 - taps) * channels];
+        } else {
+            // The taps straddle the start of the ring.
+            UInt32 source = base + 1 + ringFrames - taps;
+
+            for (UInt32 tap = 0; tap < taps; tap++) {
+                if (source == ringFrames)
+                    source = 0;
+                for (UInt32 channel = 0; channel < channels; channel++)
+                    wrapped[tap * channels + channel] = ring[source * channels + channel];
+                source++;
+            }
+            window = wrapped;
+        }
+
+        // With taps a multiple of 4 and at least two channels the window is
+        // a whole number of 8-sample steps.
+        for (UInt32 index = 0; index < windowSamples; index += 8) {
+            __m128 sample0 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)&window[index]));
+            __m128 sample1 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)&window[index + 4]));
+
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(sample0, _mm_loadu_ps(&coeff[index])));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(sample1, _mm_loadu_ps(&coeff[index + 4])));
+        }
+
+        acc0 = _mm_add_ps(acc0, acc1);
+        acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+        acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(1, 1, 1, 1)));
+        block[frame] = _mm_cvtss_f32(acc0) * (gain + gainStep * frame);
+
+        base += decimationWhole;
+        phase += decimationFraction;
+        if (phase >= interpolation) {
+            phase -= interpolation;
+            base++;
+        }
+        if (base >= ringFrames)
+            base -= ringFrames;
+    }
+}
+
+#endif /* AMDMicrophoneResampler_hpp */
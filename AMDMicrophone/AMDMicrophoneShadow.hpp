@@ -0,0 +1,127 @@
+//
+//  AMDMicrophoneShadow.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneShadow_hpp
+#define AMDMicrophoneShadow_hpp
+
+#include "AMDMicrophoneACP.hpp"
+
+// Register accesses issued to the bus and those served from the shadow.
+struct AMDMicrophoneMMIOCounts {
+    UInt64 reads;
+    UInt64 writes;
+    UInt64 readsAvoided;
+    UInt64 writesAvoided;
+};
+
+// Bus decorator that keeps a copy of the ACP configuration registers. A
+// write of the value a register already holds is dropped, and a read of a
+// known register, such as the read half of a read-modify-write, is answered
+// from the copy. Status, counter and trigger registers are not in the table
+// and always reach the hardware; so do the PTEs, whose read-back is a check
+// of the hardware. A soft reset or a power state change clears the copy.
+// Map is the register map of the ACP generation.
+//
+// The configuration registers are only touched from the work loop; the
+// counters may also move from the interrupt and audio threads.
+template <typename Bus, typename Map = AMDMicrophoneRenoir>
+class AMDMicrophoneShadow : public Bus {
+    enum {
+        kShadowRegisters = 13,
+    };
+
+    UInt32 values[kShadowRegisters];
+    UInt32 valid = 0;
+
+    static SInt32 slot(UInt32 reg);
+
+public:
+    AMDMicrophoneMMIOCounts counts = {};
+
+    UInt32 readl(UInt32 reg);
+    void writel(UInt32 val, UInt32 reg);
+    void invalidate() { valid = 0; }
+};
+
+template <typename Bus, typename Map>
+SInt32 AMDMicrophoneShadow<Bus, Map>::slot(UInt32 reg)
+{
+    switch (reg) {
+    case Map::atuPageSizeGrp1:
+        return 0;
+    case Map::atuBaseAddrGrp1:
+        return 1;
+    case Map::control:
+        return 2;
+    case Map::clkmuxSel:
+        return 3;
+    case Map::externalIntrEnb:
+        return 4;
+    case Map::externalIntrCntl:
+        return 5;
+    case Map::wovPdmEnable:
+        return 6;
+    case Map::wovRxRingbufAddr:
+        return 7;
+    case Map::wovRxRingbufSize:
+        return 8;
+    case Map::wovRxWatermarkSize:
+        return 9;
+    case Map::wovPdmChannels:
+        return 10;
+    case Map::wovPdmDecimation:
+        return 11;
+    case Map::wovMiscCtrl:
+        return 12;
+    default:
+        return -1;
+    }
+}
+
+template <typename Bus, typename Map>
+UInt32 AMDMicrophoneShadow<Bus, Map>::readl(UInt32 reg)
+{
+    SInt32 index = slot(reg);
+    UInt32 val;
+
+    if (index >= 0 && (valid & BIT(index))) {
+        __atomic_fetch_add(&counts.readsAvoided, 1, __ATOMIC_RELAXED);
+        return values[index];
+    }
+
+    __atomic_fetch_add(&counts.reads, 1, __ATOMIC_RELAXED);
+    val = Bus::readl(reg);
+
+    if (index >= 0) {
+        values[index] = val;
+        valid |= BIT(index);
+    }
+
+    return val;
+}
+
+template <typename Bus, typename Map>
+void AMDMicrophoneShadow<Bus, Map>::writel(UInt32 val, UInt32 reg)
+{
+    SInt32 index = slot(reg);
+
+    if (index >= 0 && (valid & BIT(index)) && values[index] == val) {
+        __atomic_fetch_add(&counts.writesAvoided, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_fetch_add(&counts.writes, 1, __ATOMIC_RELAXED);
+    Bus::writel(val, reg);
+
+    if (index >= 0) {
+        values[index] = val;
+        valid |= BIT(index);
+    } else if (reg == Map::softReset || reg == Map::pgfsmControl)
+        invalidate();
+}
+
+#endif /* AMDMicrophoneShadow_hpp */
@@ -0,0 +1,168 @@
+//
+//  AMDMicrophoneStats.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneStats_hpp
+#define AMDMicrophoneStats_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+#ifndef KERNEL
+#include <stdio.h>
+#endif
+
+#define STATS_HISTOGRAM_BUCKETS 32
+
+enum {
+    kStatConvertInputSamples,
+    kStatInterruptHandler,
+    kStatGetCurrentSampleFrame,
+    kStatNoiseSuppressor,
+    kStatVoiceDetector,
+    kStatCount
+};
+
+static const char* const statNames[kStatCount] = {
+    "ConvertInputSamples",
+    "InterruptHandler",
+    "GetCurrentSampleFrame",
+    "NoiseSuppressor",
+    "VoiceDetector",
+};
+
+struct AMDMicrophoneStat {
+    UInt64 calls;
+    UInt64 cycles;
+    UInt64 maxCycles;
+    // Bucket n counts calls that took [2^n, 2^(n+1)) TSC cycles.
+    UInt64 histogram[STATS_HISTOGRAM_BUCKETS];
+};
+
+// Per-path call counts and TSC cycle histograms. Recording is off by default
+// and costs one predictable branch on entry and exit while off. Counters are
+// bumped with relaxed atomics since the paths can run on several threads.
+class AMDMicrophoneStats {
+public:
+    bool enabled = false;
+    UInt64 enableCycles = 0;
+    UInt64 enableNanoseconds = 0;
+    AMDMicrophoneStat stats[kStatCount];
+
+    static UInt64 readCycles()
+    {
+        UInt32 low, high;
+
+        asm volatile("rdtsc" : "=a"(low), "=d"(high));
+        return ((UInt64)high << 32) | low;
+    }
+
+    void enable(UInt64 nowNanoseconds);
+    void disable() { __atomic_store_n(&enabled, false, __ATOMIC_RELAXED); }
+    void record(UInt32 index, UInt64 cycles);
+    UInt64 cyclesPerMicrosecond(UInt64 nowNanoseconds) const;
+
+#ifndef KERNEL
+    void dump(FILE* file, UInt64 nowNanoseconds) const;
+#endif
+};
+
+// Times the enclosing scope into one of the counters. The pointer form
+// accepts NULL for code that may run without a stats owner.
+class AMDMicrophoneProbe {
+    AMDMicrophoneStats* stats;
+    UInt32 index;
+    UInt64 start;
+
+public:
+    AMDMicrophoneProbe(AMDMicrophoneStats* owner, UInt32 statIndex)
+        : stats(NULL)
+        , index(statIndex)
+        , start(0)
+    {
+        if (owner && __builtin_expect(__atomic_load_n(&owner->enabled, __ATOMIC_RELAXED), 0)) {
+            stats = owner;
+            start = AMDMicrophoneStats::readCycles();
+        }
+    }
+
+    AMDMicrophoneProbe(AMDMicrophoneStats& owner, UInt32 statIndex)
+        : AMDMicrophoneProbe(&owner, statIndex)
+    {
+    }
+
+    ~AMDMicrophoneProbe()
+    {
+        if (__builtin_expect(stats != NULL, 0))
+            stats->record(index, AMDMicrophoneStats::readCycles() - start);
+    }
+};
+
+inline void AMDMicrophoneStats::enable(UInt64 nowNanoseconds)
+{
+    for (UInt32 index = 0; index < kStatCount; index++) {
+        AMDMicrophoneStat* stat = &stats[index];
+
+        stat->calls = 0;
+        stat->cycles = 0;
+        stat->maxCycles = 0;
+        for (UInt32 bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++)
+            stat->histogram[bucket] = 0;
+    }
+
+    enableCycles = readCycles();
+    enableNanoseconds = nowNanoseconds;
+    __atomic_store_n(&enabled, true, __ATOMIC_RELEASE);
+}
+
+inline void AMDMicrophoneStats::record(UInt32 index, UInt64 cycles)
+{
+    AMDMicrophoneStat* stat = &stats[index];
+    UInt32 bucket = 63 - __builtin_clzll(cycles | 1);
+    UInt64 previous = __atomic_load_n(&stat->maxCycles, __ATOMIC_RELAXED);
+
+    if (bucket >= STATS_HISTOGRAM_BUCKETS)
+        bucket = STATS_HISTOGRAM_BUCKETS - 1;
+
+    __atomic_fetch_add(&stat->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat->cycles, cycles, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat->histogram[bucket], 1, __ATOMIC_RELAXED);
+    while (cycles > previous
+           && !__atomic_compare_exchange_n(&stat->maxCycles, &previous, cycles, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// The TSC rate is calibrated against host time since recording was enabled,
+// so no frequency has to be known up front.
+inline UInt64 AMDMicrophoneStats::cyclesPerMicrosecond(UInt64 nowNanoseconds) const
+{
+    UInt64 elapsed = (nowNanoseconds - enableNanoseconds) / 1000;
+
+    if (!enabled || !elapsed)
+        return 0;
+
+    return (readCycles() - enableCycles) / elapsed;
+}
+
+#ifndef KERNEL
+inline void AMDMicrophoneStats::dump(FILE* file, UInt64 nowNanoseconds) const
+{
+    fprintf(file, "cycles/us %llu\n", (unsigned long long)cyclesPerMicrosecond(nowNanoseconds));
+    for (UInt32 index = 0; index < kStatCount; index++) {
+        const AMDMicrophoneStat* stat = &stats[index];
+
+        fprintf(
+            file, "%s: calls %llu cycles %llu max %llu\n", statNames[index], (unsigned long long)stat->calls,
+            (unsigned long long)stat->cycles, (unsigned long long)stat->maxCycles
+        );
+        for (UInt32 bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; bucket++) {
+            if (stat->histogram[bucket])
+                fprintf(file, "  2^%-2u %llu\n", bucket, (unsigned long long)stat->histogram[bucket]);
+        }
+    }
+}
+#endif
+
+#endif /* AMDMicrophoneStats_hpp */
@@ -0,0 +1,204 @@
+//
+//  AMDMicrophoneSuppressor.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneSuppressor_hpp
+#define AMDMicrophoneSuppressor_hpp
+
+#include "AMDMicrophoneFFT.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#include <emmintrin.h>
+
+#define SUPPRESSOR_HOP             (FFT_SIZE / 2)
+#define SUPPRESSOR_LATENCY         FFT_SIZE
+#define SUPPRESSOR_SMOOTHING       0.8f
+#define SUPPRESSOR_PRIOR_SMOOTHING 0.98f
+#define SUPPRESSOR_BIAS            1.5f
+#define SUPPRESSOR_SUBWINDOWS      8
+#define SUPPRESSOR_WINDOW_SECONDS  1.5
+#define SUPPRESSOR_NOISE_FLOOR     1e-12f
+#define SUPPRESSOR_UNSET           1e30f
+
+// Spectral noise suppressor for the mono signal. Frames of FFT_SIZE samples
+// with a square-root Hann window are taken every SUPPRESSOR_HOP samples,
+// scaled per bin by a Wiener gain and overlap-added through the same window.
+// The noise spectrum is the minimum of the smoothed power over the last
+// SUPPRESSOR_WINDOW_SECONDS, tracked in SUPPRESSOR_SUBWINDOWS pieces, so it
+// follows fan noise but not speech; the a priori SNR uses the
+// decision-directed estimate to keep musical noise down.
+//
+// Output lags input by SUPPRESSOR_LATENCY frames at the client rate: 5.3 ms
+// at 48 kHz, 16 ms at 16 kHz. All state is preallocated; process() runs in
+// place on any block length.
+class AMDMicrophoneSuppressor {
+    AMDMicrophoneFFT fft;
+    float window[FFT_SIZE];
+    float input[FFT_SIZE];
+    float overlap[FFT_SIZE];
+    float frame[FFT_SIZE];
+    float real[FFT_PADDED];
+    float imag[FFT_PADDED];
+    float smoothed[FFT_PADDED];
+    float clean[FFT_PADDED];
+    float subwindowMinimum[FFT_PADDED];
+    float windowMinimum[FFT_PADDED];
+    float history[SUPPRESSOR_SUBWINDOWS][FFT_PADDED];
+    UInt32 fill = 0;
+    UInt32 subwindowHops = 1;
+    UInt32 subwindowHop = 0;
+    UInt32 historyIndex = 0;
+    bool primed = false;
+
+    void processHop(float minimumGain);
+
+public:
+    void configure(UInt32 sampleRate);
+    void reset();
+    void process(float* block, UInt32 numFrames, float minimumGain);
+};
+
+inline void AMDMicrophoneSuppressor::configure(UInt32 sampleRate)
+{
+    const double pi = 3.14159265358979323846;
+
+    fft.configure();
+    for (UInt32 index = 0; index < FFT_SIZE; index++)
+        window[index] = (float)AMDMicrophoneResampler::sine(pi * index / FFT_SIZE);
+
+    subwindowHops = (UInt32)(SUPPRESSOR_WINDOW_SECONDS * sampleRate / (SUPPRESSOR_HOP * SUPPRESSOR_SUBWINDOWS));
+    if (!subwindowHops)
+        subwindowHops = 1;
+    reset();
+}
+
+inline void AMDMicrophoneSuppressor::reset()
+{
+    for (UInt32 index = 0; index < FFT_SIZE; index++) {
+        input[index] = 0.0f;
+        overlap[index] = 0.0f;
+    }
+    for (UInt32 bin = 0; bin < FFT_PADDED; bin++) {
+        smoothed[bin] = 0.0f;
+        clean[bin] = 0.0f;
+        subwindowMinimum[bin] = SUPPRESSOR_UNSET;
+        windowMinimum[bin] = SUPPRESSOR_UNSET;
+        for (UInt32 subwindow = 0; subwindow < SUPPRESSOR_SUBWINDOWS; subwindow++)
+            history[subwindow][bin] = SUPPRESSOR_UNSET;
+    }
+    fill = 0;
+    subwindowHop = 0;
+    historyIndex = 0;
+    primed = false;
+}
+
+// Gains below minimumGain are raised to it, which bounds the attenuation.
+inline void AMDMicrophoneSuppressor::process(float* block, UInt32 numFrames, float minimumGain)
+{
+    while (numFrames > 0) {
+        UInt32 chunk = SUPPRESSOR_HOP - fill;
+
+        if (chunk > numFrames)
+            chunk = numFrames;
+
+        for (UInt32 index = 0; index < chunk; index++) {
+            input[SUPPRESSOR_HOP + fill + index] = block[index];
+            block[index] = overlap[fill + index];
+        }
+
+        fill += chunk;
+        block += chunk;
+        numFrames -= chunk;
+
+        if (fill == SUPPRESSOR_HOP) {
+            processHop(minimumGain);
+            fill = 0;
+        }
+    }
+}
+
+inline void AMDMicrophoneSuppressor::processHop(float minimumGain)
+{
+    const __m128 smoothing = _mm_set1_ps(SUPPRESSOR_SMOOTHING);
+    const __m128 smoothingRest = _mm_set1_ps(1.0f - SUPPRESSOR_SMOOTHING);
+    const __m128 prior = _mm_set1_ps(SUPPRESSOR_PRIOR_SMOOTHING);
+    const __m128 priorRest = _mm_set1_ps(1.0f - SUPPRESSOR_PRIOR_SMOOTHING);
+    const __m128 bias = _mm_set1_ps(SUPPRESSOR_BIAS);
+    const __m128 noiseFloor = _mm_set1_ps(SUPPRESSOR_NOISE_FLOOR);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 gainFloor = _mm_set1_ps(minimumGain);
+    bool endOfSubwindow = ++subwindowHop == subwindowHops;
+
+    for (UInt32 index = 0; index < FFT_SIZE; index += 4)
+        _mm_storeu_ps(&frame[index], _mm_mul_ps(_mm_loadu_ps(&input[index]), _mm_loadu_ps(&window[index])));
+    fft.forward(frame, real, imag);
+
+    if (!primed) {
+        for (UInt32 bin = 0; bin < FFT_PADDED; bin++)
+            smoothed[bin] = real[bin] * real[bin] + imag[bin] * imag[bin];
+        primed = true;
+    }
+
+    for (UInt32 bin = 0; bin < FFT_BINS; bin += 4) {
+        __m128 re = _mm_loadu_ps(&real[bin]);
+        __m128 im = _mm_loadu_ps(&imag[bin]);
+        __m128 power = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        __m128 smooth = _mm_add_ps(
+            _mm_mul_ps(smoothing, _mm_loadu_ps(&smoothed[bin])), _mm_mul_ps(smoothingRest, power)
+        );
+        __m128 subwindowMin = _mm_min_ps(_mm_loadu_ps(&subwindowMinimum[bin]), smooth);
+        __m128 noise = _mm_add_ps(
+            _mm_mul_ps(bias, _mm_min_ps(subwindowMin, _mm_loadu_ps(&windowMinimum[bin]))), noiseFloor
+        );
+        __m128 posterior = _mm_sub_ps(_mm_div_ps(power, noise), one);
+        __m128 priorSnr = _mm_add_ps(
+            _mm_mul_ps(prior, _mm_div_ps(_mm_loadu_ps(&clean[bin]), noise)),
+            _mm_mul_ps(priorRest, _mm_max_ps(posterior, _mm_setzero_ps()))
+        );
+        __m128 gain = _mm_max_ps(_mm_div_ps(priorSnr, _mm_add_ps(priorSnr, one)), gainFloor);
+
+        _mm_storeu_ps(&smoothed[bin], smooth);
+        _mm_storeu_ps(&subwindowMinimum[bin], subwindowMin);
+        _mm_storeu_ps(&clean[bin], _mm_mul_ps(_mm_mul_ps(gain, gain), power));
+        _mm_storeu_ps(&real[bin], _mm_mul_ps(re, gain));
+        _mm_storeu_ps(&imag[bin], _mm_mul_ps(im, gain));
+    }
+
+    // Retire the finished subwindow into the history and restart it from the
+    // current smoothed power.
+    if (endOfSubwindow) {
+        float* retired = history[historyIndex];
+
+        historyIndex = (historyIndex + 1) % SUPPRESSOR_SUBWINDOWS;
+        subwindowHop = 0;
+        for (UInt32 bin = 0; bin < FFT_BINS; bin += 4) {
+            __m128 minimum = _mm_loadu_ps(&subwindowMinimum[bin]);
+
+            _mm_storeu_ps(&retired[bin], minimum);
+            for (UInt32 subwindow = 0; subwindow < SUPPRESSOR_SUBWINDOWS; subwindow++)
+                minimum = _mm_min_ps(minimum, _mm_loadu_ps(&history[subwindow][bin]));
+            _mm_storeu_ps(&windowMinimum[bin], minimum);
+            _mm_storeu_ps(&subwindowMinimum[bin], _mm_loadu_ps(&smoothed[bin]));
+        }
+    }
+
+    fft.inverse(real, imag, frame);
+
+    // The first half completes the samples handed out over the next hop; the
+    // second half waits for the next frame.
+    for (UInt32 index = 0; index < SUPPRESSOR_HOP; index += 4) {
+        __m128 head = _mm_mul_ps(_mm_loadu_ps(&frame[index]), _mm_loadu_ps(&window[index]));
+        __m128 tail = _mm_mul_ps(
+            _mm_loadu_ps(&frame[SUPPRESSOR_HOP + index]), _mm_loadu_ps(&window[SUPPRESSOR_HOP + index])
+        );
+
+        _mm_storeu_ps(&overlap[index], _mm_add_ps(_mm_loadu_ps(&overlap[SUPPRESSOR_HOP + index]), head));
+        _mm_storeu_ps(&overlap[SUPPRESSOR_HOP + index], tail);
+        _mm_storeu_ps(&input[index], _mm_loadu_ps(&input[SUPPRESSOR_HOP + index]));
+    }
+}
+
+#endif /* AMDMicrophoneSuppressor_hpp */
@@ -0,0 +1,287 @@
+//
+//  AMDMicrophoneTap.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneTap_hpp
+#define AMDMicrophoneTap_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+#define TAP_MAGIC   0x414D5450
+#define TAP_VERSION 1
+#define TAP_FRAMES  16384
+#define TAP_CHUNKS  256
+
+// Chunk flags. A discontinuity chunk follows frames the driver lost.
+#define TAP_CHUNK_DISCONTINUITY 0x1
+
+// Memory types of AMDMicrophoneUserClient::clientMemoryForType().
+enum {
+    kAMDMicrophoneMemoryTap,
+    kAMDMicrophoneMemoryTrace,
+};
+
+// Layout of the capture tap shared with user space. The producer appends the
+// processed mono signal and, once per conversion call, a chunk record that
+// ties a tap frame to the host time it was captured at. Frame and chunk
+// indices only grow, so they double as sequence numbers.
+//
+// Each ring has two counters. claimed is advanced before a slot is
+// overwritten and written after the data is in place. A reader copies up to
+// written and then checks claimed: anything older than claimed - capacity
+// may have been overwritten during the copy and is reported as lost, so
+// overruns are detected without the producer ever waiting on a reader.
+struct AMDMicrophoneTapChunk {
+    UInt64 sequence;
+    UInt64 firstFrame;
+    UInt64 hostTime;
+    UInt32 sampleRate;
+    UInt32 flags;
+};
+
+struct AMDMicrophoneTapHeader {
+    UInt32 magic;
+    UInt32 version;
+    UInt32 frames;
+    UInt32 chunks;
+    UInt64 ticksPerSecond;
+    UInt64 claimedFrames;
+    UInt64 writtenFrames;
+    UInt64 claimedChunks;
+    UInt64 writtenChunks;
+};
+
+struct AMDMicrophoneTapBuffer {
+    AMDMicrophoneTapHeader header;
+    AMDMicrophoneTapChunk chunks[TAP_CHUNKS];
+    float samples[TAP_FRAMES];
+};
+
+// Producer side. write(), mark() and feed() are called from one thread at a
+// time.
+//
+// feed() takes a conversion of client ring frames and passes on only the
+// frames past the last one it fed, so a second client or a re-read of the
+// same range does not repeat audio in the tap. The write() calls for the
+// frames already fed are dropped.
+class AMDMicrophoneTap {
+    AMDMicrophoneTapBuffer* buffer = NULL;
+    UInt32 ringFrames = 0;
+    UInt32 nextFrame = 0;
+    bool fed = false;
+    UInt32 dropFrames = 0;
+
+public:
+    void attach(AMDMicrophoneTapBuffer* shared, UInt64 ticksPerSecond);
+    bool isAttached() const { return buffer != NULL; }
+    void restart(UInt32 frames);
+    void mark(UInt64 hostTime, UInt32 sampleRate, UInt32 flags = 0);
+    bool feed(UInt32 firstFrame, UInt32 numFrames, UInt64 hostTime, UInt32 sampleRate, UInt32 flags = 0);
+    void write(const float* samples, UInt32 numFrames);
+};
+
+// Consumer side, for the process that maps the buffer. Each reader keeps its
+// own position; any number of them can follow the same buffer.
+class AMDMicrophoneTapReader {
+    const AMDMicrophoneTapBuffer* buffer = NULL;
+
+public:
+    UInt64 position = 0;
+    UInt64 lost = 0;
+
+    bool attach(const AMDMicrophoneTapBuffer* shared);
+    UInt32 read(float* samples, UInt32 maxFrames);
+    bool getTime(UInt64 frame, UInt64* hostTime) const;
+};
+
+inline void AMDMicrophoneTap::attach(AMDMicrophoneTapBuffer* shared, UInt64 ticksPerSecond)
+{
+    shared->header.frames = TAP_FRAMES;
+    shared->header.chunks = TAP_CHUNKS;
+    shared->header.ticksPerSecond = ticksPerSecond;
+    shared->header.claimedFrames = 0;
+    shared->header.writtenFrames = 0;
+    shared->header.claimedChunks = 0;
+    shared->header.writtenChunks = 0;
+    shared->header.version = TAP_VERSION;
+    __atomic_store_n(&shared->header.magic, TAP_MAGIC, __ATOMIC_RELEASE);
+    buffer = shared;
+}
+
+// Forgets the frames fed so far, for a ring of the given number of client
+// frames.
+inline void AMDMicrophoneTap::restart(UInt32 frames)
+{
+    ringFrames = frames;
+    nextFrame = 0;
+    fed = false;
+    dropFrames = 0;
+}
+
+// Starts a chunk at the next frame to be written.
+inline void AMDMicrophoneTap::mark(UInt64 hostTime, UInt32 sampleRate, UInt32 flags)
+{
+    AMDMicrophoneTapHeader* header = &buffer->header;
+    UInt64 sequence = header->writtenChunks;
+    AMDMicrophoneTapChunk* chunk = &buffer->chunks[sequence & (TAP_CHUNKS - 1)];
+
+    __atomic_store_n(&header->claimedChunks, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    chunk->sequence = sequence;
+    chunk->firstFrame = header->writtenFrames;
+    chunk->hostTime = hostTime;
+    chunk->sampleRate = sampleRate;
+    chunk->flags = flags;
+
+    __atomic_store_n(&header->writtenChunks, sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Starts a chunk for the ring frames from firstFrame that have not been fed
+// yet. A range that starts within half a ring behind the next frame overlaps
+// what was fed; any other start skips frames and is flagged as a
+// discontinuity. Returns false if every frame was fed before.
+inline bool AMDMicrophoneTap::feed(
+    UInt32 firstFrame, UInt32 numFrames, UInt64 hostTime, UInt32 sampleRate, UInt32 flags
+)
+{
+    UInt32 behind, endFrame;
+
+    dropFrames = 0;
+    if (!ringFrames || !numFrames) {
+        mark(hostTime, sampleRate, flags);
+        return true;
+    }
+
+    firstFrame %= ringFrames;
+    endFrame = (firstFrame + numFrames) % ringFrames;
+    behind = fed ? (nextFrame + ringFrames - firstFrame) % ringFrames : 0;
+
+    if (behind > ringFrames / 2) {
+        flags |= TAP_CHUNK_DISCONTINUITY;
+        behind = 0;
+    } else if (behind >= numFrames) {
+        dropFrames = numFrames;
+        return false;
+    }
+
+    dropFrames = behind;
+    nextFrame = endFrame;
+    fed = true;
+    if (behind)
+        hostTime += (UInt64)behind * buffer->header.ticksPerSecond / sampleRate;
+    mark(hostTime, sampleRate, flags);
+    return true;
+}
+
+inline void AMDMicrophoneTap::write(const float* samples, UInt32 numFrames)
+{
+    AMDMicrophoneTapHeader* header = &buffer->header;
+    UInt64 frame = header->writtenFrames;
+
+    if (dropFrames) {
+        UInt32 dropped = numFrames < dropFrames ? numFrames : dropFrames;
+
+        samples += dropped;
+        numFrames -= dropped;
+        dropFrames -= dropped;
+        if (!numFrames)
+            return;
+    }
+
+    if (numFrames > TAP_FRAMES) {
+        samples += numFrames - TAP_FRAMES;
+        frame += numFrames - TAP_FRAMES;
+        numFrames = TAP_FRAMES;
+    }
+
+    __atomic_store_n(&header->claimedFrames, frame + numFrames, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (UInt32 index = 0; index < numFrames; index++)
+        buffer->samples[(frame + index) & (TAP_FRAMES - 1)] = samples[index];
+
+    __atomic_store_n(&header->writtenFrames, frame + numFrames, __ATOMIC_RELEASE);
+}
+
+// Starts at the newest frame. Fails if the buffer is not a tap of this
+// version.
+inline bool AMDMicrophoneTapReader::attach(const AMDMicrophoneTapBuffer* shared)
+{
+    if (__atomic_load_n(&shared->header.magic, __ATOMIC_ACQUIRE) != TAP_MAGIC
+        || shared->header.version != TAP_VERSION || shared->header.frames != TAP_FRAMES
+        || shared->header.chunks != TAP_CHUNKS)
+        return false;
+
+    buffer = shared;
+    position = __atomic_load_n(&shared->header.writtenFrames, __ATOMIC_ACQUIRE);
+    lost = 0;
+
+    return true;
+}
+
+// Copies up to maxFrames new frames. Frames the producer overwrote before
+// they could be read are skipped and added to lost.
+inline UInt32 AMDMicrophoneTapReader::read(float* samples, UInt32 maxFrames)
+{
+    const AMDMicrophoneTapHeader* header = &buffer->header;
+    UInt64 written = __atomic_load_n(&header->writtenFrames, __ATOMIC_ACQUIRE);
+    UInt64 claimed, oldest, skip;
+    UInt32 numFrames;
+
+    if (written - position > TAP_FRAMES) {
+        lost += written - TAP_FRAMES - position;
+        position = written - TAP_FRAMES;
+    }
+
+    numFrames = written - position < maxFrames ? (UInt32)(written - position) : maxFrames;
+    for (UInt32 index = 0; index < numFrames; index++)
+        samples[index] = buffer->samples[(position + index) & (TAP_FRAMES - 1)];
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    claimed = __atomic_load_n(&header->claimedFrames, __ATOMIC_RELAXED);
+    oldest = claimed > TAP_FRAMES ? claimed - TAP_FRAMES : 0;
+
+    if (oldest > position) {
+        skip = oldest - position;
+        if (skip > numFrames)
+            skip = numFrames;
+        for (UInt32 index = 0; index + skip < numFrames; index++)
+            samples[index] = samples[index + skip];
+        numFrames -= (UInt32)skip;
+        lost += oldest - position;
+        position = oldest;
+    }
+
+    position += numFrames;
+    return numFrames;
+}
+
+// Host time of a frame, extrapolated from the newest chunk that starts at or
+// before it. Fails if that chunk has already been recycled.
+inline bool AMDMicrophoneTapReader::getTime(UInt64 frame, UInt64* hostTime) const
+{
+    const AMDMicrophoneTapHeader* header = &buffer->header;
+    UInt64 written = __atomic_load_n(&header->writtenChunks, __ATOMIC_ACQUIRE);
+
+    for (UInt64 sequence = written; sequence-- > 0 && written - sequence <= TAP_CHUNKS;) {
+        AMDMicrophoneTapChunk chunk = buffer->chunks[sequence & (TAP_CHUNKS - 1)];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->claimedChunks, __ATOMIC_RELAXED) - sequence > TAP_CHUNKS
+            || chunk.sequence != sequence || !chunk.sampleRate)
+            return false;
+        if (chunk.firstFrame > frame)
+            continue;
+
+        *hostTime = chunk.hostTime + (frame - chunk.firstFrame) * header->ticksPerSecond / chunk.sampleRate;
+        return true;
+    }
+
+    return false;
+}
+
+#endif /* AMDMicrophoneTap_hpp */
@@ -0,0 +1,352 @@
+//
+//  AMDMicrophoneTrace.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneTrace_hpp
+#define AMDMicrophoneTrace_hpp
+
+#include "AMDMicrophoneACP.hpp"
+#include "AMDMicrophoneStats.hpp"
+#include "AMDMicrophoneTypes.hpp"
+
+#ifdef KERNEL
+#include <IOKit/IOLib.h>
+#else
+#include <pthread.h>
+#endif
+
+#define TRACE_MAGIC   0x414D5452
+#define TRACE_VERSION 2
+#define TRACE_EVENTS  8192
+#define TRACE_THREADS 16
+
+enum {
+    kTraceRead,
+    kTraceWrite,
+    kTraceEnter,
+    kTraceExit,
+};
+
+// Driver entry points bracketed by kTraceEnter and kTraceExit markers, see
+// AMDMicrophoneTraceScope. Each runs one register sequence of
+// AMDMicrophoneACP, so the replay can run it again.
+enum {
+    kTraceEntryInterrupt,
+    kTraceEntryConvert,
+    kTraceEntryCurrentFrame,
+    kTraceEntryPowerUp,
+    kTraceEntryPowerDown,
+    kTraceEntryStartCapture,
+    kTraceEntryStopCapture,
+    kTraceEntryStopListening,
+    kTraceEntryCount
+};
+
+static const char* const traceEntryNames[kTraceEntryCount] = {
+    "interrupt",
+    "convert",
+    "currentFrame",
+    "powerUp",
+    "powerDown",
+    "startCapture",
+    "stopCapture",
+    "stopListening",
+};
+
+// Argument of a kTraceEntryStartCapture marker.
+#define TRACE_CAPTURE_ARGUMENT(watermarkSize, channels) ((watermarkSize) | (channels) << 24)
+#define TRACE_CAPTURE_WATERMARK(argument)               ((argument) & 0xFFFFFF)
+#define TRACE_CAPTURE_CHANNELS(argument)                ((argument) >> 24)
+
+// One traced event. For register accesses reg and value are the offset and
+// the value read or written, see traceValue(). For markers reg is the entry
+// point and value its argument on entry and its result on exit. thread
+// numbers the threads in the order they first recorded, from 1; 0 is a
+// thread beyond TRACE_THREADS. sequence is index + 1 once the slot is
+// complete and 0 while it is being written.
+struct AMDMicrophoneTraceEvent {
+    UInt64 sequence;
+    UInt64 cycles;
+    UInt32 type;
+    UInt32 reg;
+    UInt32 value;
+    UInt32 thread;
+};
+
+// pages and bufferSize describe the DMA ring the entry points program.
+// cyclesPerMicrosecond is 0 in the live buffer; the dump tool measures it.
+struct AMDMicrophoneTraceHeader {
+    UInt32 magic;
+    UInt32 version;
+    UInt32 events;
+    UInt32 pages;
+    UInt64 claimed;
+    UInt32 bufferSize;
+    UInt32 cyclesPerMicrosecond;
+};
+
+struct AMDMicrophoneTraceBuffer {
+    AMDMicrophoneTraceHeader header;
+    AMDMicrophoneTraceEvent events[TRACE_EVENTS];
+};
+
+// Flight recorder of the register traffic, shared with user space like the
+// capture tap. Any thread may record: a slot is claimed with one atomic add
+// and published through its sequence word, so the interrupt, audio and work
+// loop threads never wait on each other. The oldest events are overwritten.
+// Threads are numbered through a table that stays in the driver, so no
+// kernel pointer reaches the buffer.
+class AMDMicrophoneTrace {
+    AMDMicrophoneTraceBuffer* buffer = NULL;
+    uintptr_t threads[TRACE_THREADS] = {};
+
+    UInt32 currentThread();
+
+public:
+    void attach(AMDMicrophoneTraceBuffer* shared, UInt32 bufferSize, UInt32 pages);
+    bool isAttached() const { return buffer != NULL; }
+    void record(UInt32 type, UInt32 reg, UInt32 value);
+    static UInt64 copy(const AMDMicrophoneTraceBuffer* shared, AMDMicrophoneTraceEvent* events, UInt64 maxEvents);
+};
+
+// Brackets a driver entry point in the trace. The exit marker carries
+// result, which the entry point sets before it returns.
+class AMDMicrophoneTraceScope {
+    AMDMicrophoneTrace& trace;
+    UInt32 entry;
+
+public:
+    UInt32 result = 0;
+
+    AMDMicrophoneTraceScope(AMDMicrophoneTrace& owner, UInt32 entryPoint, UInt32 argument = 0)
+        : trace(owner)
+        , entry(entryPoint)
+    {
+        if (trace.isAttached())
+            trace.record(kTraceEnter, entry, argument);
+    }
+
+    ~AMDMicrophoneTraceScope()
+    {
+        if (trace.isAttached())
+            trace.record(kTraceExit, entry, result);
+    }
+};
+
+inline void AMDMicrophoneTrace::attach(AMDMicrophoneTraceBuffer* shared, UInt32 bufferSize, UInt32 pages)
+{
+    shared->header.events = TRACE_EVENTS;
+    shared->header.claimed = 0;
+    shared->header.version = TRACE_VERSION;
+    shared->header.pages = pages;
+    shared->header.bufferSize = bufferSize;
+    shared->header.cyclesPerMicrosecond = 0;
+    __atomic_store_n(&shared->header.magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+    buffer = shared;
+}
+
+inline UInt32 AMDMicrophoneTrace::currentThread()
+{
+#ifdef KERNEL
+    uintptr_t self = (uintptr_t)IOThreadSelf();
+#else
+    uintptr_t self = (uintptr_t)pthread_self();
+#endif
+
+    for (UInt32 index = 0; index < TRACE_THREADS; index++) {
+        uintptr_t thread = __atomic_load_n(&threads[index], __ATOMIC_RELAXED);
+
+        if (thread == self)
+            return index + 1;
+        if (!thread) {
+            uintptr_t expected = 0;
+
+            if (__atomic_compare_exchange_n(&threads[index], &expected, self, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+                || expected == self)
+                return index + 1;
+        }
+    }
+
+    return 0;
+}
+
+inline void AMDMicrophoneTrace::record(UInt32 type, UInt32 reg, UInt32 value)
+{
+    UInt32 thread = currentThread();
+    UInt64 index = __atomic_fetch_add(&buffer->header.claimed, 1, __ATOMIC_RELAXED);
+    AMDMicrophoneTraceEvent* event = &buffer->events[index & (TRACE_EVENTS - 1)];
+
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    event->cycles = AMDMicrophoneStats::readCycles();
+    event->type = type;
+    event->reg = reg;
+    event->value = value;
+    event->thread = thread;
+
+    __atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+// Copies the newest complete events, oldest first, from a live or dumped
+// buffer. Slots still being written or already overwritten again end the
+// copy early, so the result is always a gap-free run of the trace.
+inline UInt64 AMDMicrophoneTrace::copy(
+    const AMDMicrophoneTraceBuffer* shared, AMDMicrophoneTraceEvent* events, UInt64 maxEvents
+)
+{
+    UInt64 claimed = __atomic_load_n(&shared->header.claimed, __ATOMIC_ACQUIRE);
+    UInt64 count = claimed < TRACE_EVENTS ? claimed : TRACE_EVENTS;
+    UInt64 copied = 0;
+
+    if (count > maxEvents)
+        count = maxEvents;
+
+    for (UInt64 index = claimed - count; index < claimed; index++) {
+        const AMDMicrophoneTraceEvent* slot = &shared->events[index & (TRACE_EVENTS - 1)];
+        UInt64 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        events[copied] = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (sequence != index + 1 || __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence) {
+            // A torn slot at the old end is dropped; one at the new end
+            // stops the copy there.
+            if (copied)
+                break;
+            continue;
+        }
+        copied++;
+    }
+
+    return copied;
+}
+
+// The value a register access is traced with. PTE words hold physical
+// addresses, so only the page offset of a low word and the valid bit of a
+// high word are kept; both are 0 and BIT(31) for a well-formed table.
+template <typename Map>
+inline UInt32 traceValue(UInt32 reg, UInt32 val)
+{
+    if (!isPTERegister<Map>(reg))
+        return val;
+
+    return reg & 4 ? val & BIT(31) : val & (ACP_DMA_PAGE_SIZE - 1);
+}
+
+// Bus decorator that records every access that reaches the inner bus.
+template <typename Bus, typename Map = AMDMicrophoneRenoir>
+class AMDMicrophoneTraceBus : public Bus {
+public:
+    AMDMicrophoneTrace* trace = NULL;
+
+    UInt32 readl(UInt32 reg)
+    {
+        UInt32 val = Bus::readl(reg);
+
+        if (trace)
+            trace->record(kTraceRead, reg, traceValue<Map>(reg, val));
+        return val;
+    }
+
+    void writel(UInt32 val, UInt32 reg)
+    {
+        Bus::writel(val, reg);
+        if (trace)
+            trace->record(kTraceWrite, reg, traceValue<Map>(reg, val));
+    }
+};
+
+// Bus that plays a recorded trace back into the driver code: reads return
+// the recorded values and writes are checked against the recording, both
+// masked like traceValue(). PTE reads return what the replayed code wrote,
+// since the trace holds no addresses. Event markers are skipped. The first
+// access that does not match is kept in divergence, after which reads
+// return 0. With cyclesPerMicrosecond set, the recorded gap after each
+// delay() is checked to be at least as long as the delay asked for.
+template <typename Map = AMDMicrophoneRenoir>
+class AMDMicrophoneTraceReplay {
+    const AMDMicrophoneTraceEvent* events = NULL;
+    UInt64 count = 0;
+    UInt32 ptes[ACP_PTE_WINDOW / 4] = {};
+    UInt64 requestedDelay = 0;
+
+    const AMDMicrophoneTraceEvent* next(UInt32 type, UInt32 reg, UInt32 value);
+
+public:
+    UInt64 position = 0;
+    UInt64 accesses = 0;
+    bool diverged = false;
+    UInt64 divergence = 0;
+    UInt32 cyclesPerMicrosecond = 0;
+    UInt64 shortDelays = 0;
+
+    void load(const AMDMicrophoneTraceEvent* trace, UInt64 numEvents)
+    {
+        events = trace;
+        count = numEvents;
+        position = 0;
+        accesses = 0;
+        diverged = false;
+        requestedDelay = 0;
+    }
+
+    UInt32 readl(UInt32 reg)
+    {
+        const AMDMicrophoneTraceEvent* event = next(kTraceRead, reg, 0);
+
+        if (!event)
+            return 0;
+        if (isPTERegister<Map>(reg))
+            return ptes[(reg - Map::scratchReg0) / 4];
+        return event->value;
+    }
+
+    void writel(UInt32 val, UInt32 reg)
+    {
+        if (isPTERegister<Map>(reg))
+            ptes[(reg - Map::scratchReg0) / 4] = val;
+        next(kTraceWrite, reg, val);
+    }
+    void delay(UInt32 us) { requestedDelay += us; }
+    void relax() { }
+};
+
+template <typename Map>
+inline const AMDMicrophoneTraceEvent* AMDMicrophoneTraceReplay<Map>::next(UInt32 type, UInt32 reg, UInt32 value)
+{
+    const AMDMicrophoneTraceEvent* event;
+
+    while (position < count && events[position].type != kTraceRead && events[position].type != kTraceWrite)
+        position++;
+
+    if (diverged)
+        return NULL;
+
+    if (position == count) {
+        diverged = true;
+        divergence = position;
+        return NULL;
+    }
+
+    event = &events[position];
+    if (event->type != type || event->reg != reg
+        || (type == kTraceWrite && traceValue<Map>(reg, event->value) != traceValue<Map>(reg, value))) {
+        diverged = true;
+        divergence = position;
+        return NULL;
+    }
+
+    if (requestedDelay && cyclesPerMicrosecond && accesses
+        && event->cycles - events[position - 1].cycles < requestedDelay * cyclesPerMicrosecond)
+        shortDelays++;
+    requestedDelay = 0;
+
+    position++;
+    accesses++;
+    return event;
+}
+
+#endif /* AMDMicrophoneTrace_hpp */
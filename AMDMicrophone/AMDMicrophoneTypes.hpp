@@ -0,0 +1,40 @@
+//
+//  AMDMicrophoneTypes.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneTypes_hpp
+#define AMDMicrophoneTypes_hpp
+
+// The kernel types used by the portable headers. Inside the kext they come
+// from the SDK; on a host build they are defined here with the same widths
+// and values.
+
+#include <stdint.h>
+
+#ifdef KERNEL
+#include <IOKit/IOReturn.h>
+#include <libkern/OSTypes.h>
+#else
+#include <stddef.h>
+
+typedef uint8_t UInt8;
+typedef uint16_t UInt16;
+typedef int16_t SInt16;
+typedef uint32_t UInt32;
+typedef int32_t SInt32;
+typedef uint64_t UInt64;
+typedef int64_t SInt64;
+typedef int IOReturn;
+
+#define kIOReturnSuccess     0
+#define kIOReturnError       ((IOReturn)0xe00002bc)
+#define kIOReturnBadArgument ((IOReturn)0xe00002c2)
+#define kIOReturnIOError     ((IOReturn)0xe00002ca)
+#define kIOReturnUnsupported ((IOReturn)0xe00002c7)
+#define kIOReturnTimeout     ((IOReturn)0xe00002d6)
+#endif
+
+#endif /* AMDMicrophoneTypes_hpp */
@@ -0,0 +1,79 @@
+//
+//  AMDMicrophoneUserClient.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#include "AMDMicrophoneUserClient.hpp"
+
+#include "AMDMicrophoneCommon.hpp"
+#include "AMDMicrophoneDevice.hpp"
+
+#define super IOUserClient
+
+OSDefineMetaClassAndStructors(AMDMicrophoneUserClient, IOUserClient);
+
+bool AMDMicrophoneUserClient::initWithTask(task_t owningTask, void* securityID, UInt32 type, OSDictionary* properties)
+{
+    OSObject* entitlement;
+    bool entitled;
+
+    if (!super::initWithTask(owningTask, securityID, type, properties))
+        return false;
+
+    if (clientHasPrivilege(securityID, kIOClientPrivilegeAdministrator) == kIOReturnSuccess)
+        return true;
+
+    entitlement = copyClientEntitlement(owningTask, CLIENT_ENTITLEMENT);
+    entitled = entitlement == kOSBooleanTrue;
+    if (entitlement)
+        entitlement->release();
+
+    if (!entitled)
+        LOG("Client is neither an administrator nor entitled\n");
+
+    return entitled;
+}
+
+bool AMDMicrophoneUserClient::start(IOService* provider)
+{
+    device = OSDynamicCast(AMDMicrophoneDevice, provider);
+    if (!device)
+        return false;
+
+    return super::start(provider);
+}
+
+IOReturn AMDMicrophoneUserClient::clientClose()
+{
+    if (!isInactive())
+        terminate();
+
+    return kIOReturnSuccess;
+}
+
+// The tap only exists when CaptureTap is set, the trace when RegisterTrace
+// is set. initWithTask() has already checked the client's privilege. The
+// mappings are read-only so a client cannot disturb the producers or the
+// other readers.
+IOReturn AMDMicrophoneUserClient::clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory)
+{
+    IOBufferMemoryDescriptor* descriptor;
+
+    if (type == kAMDMicrophoneMemoryTap)
+        descriptor = device->tapDescriptor;
+    else if (type == kAMDMicrophoneMemoryTrace)
+        descriptor = device->traceDescriptor;
+    else
+        return kIOReturnBadArgument;
+
+    if (!descriptor)
+        return kIOReturnUnsupported;
+
+    descriptor->retain();
+    *options = kIOMapReadOnly;
+    *memory = descriptor;
+
+    return kIOReturnSuccess;
+}
@@ -0,0 +1,36 @@
+//
+//  AMDMicrophoneUserClient.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneUserClient_hpp
+#define AMDMicrophoneUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+class AMDMicrophoneDevice;
+
+// Entitlement that lets a process other than an administrator's open the
+// connection.
+#define CLIENT_ENTITLEMENT "com.qhuyduong.AMDMicrophone.client"
+
+// Gives user space read-only mappings of the driver's shared buffers, see
+// kAMDMicrophoneMemoryTap and kAMDMicrophoneMemoryTrace. There are no
+// methods; a client opens the connection and calls IOConnectMapMemory64. The
+// tap carries microphone audio outside Core Audio's consent prompt, so only
+// administrators and processes holding CLIENT_ENTITLEMENT may open it.
+class AMDMicrophoneUserClient : public IOUserClient {
+    OSDeclareDefaultStructors(AMDMicrophoneUserClient);
+
+    AMDMicrophoneDevice* device;
+
+public:
+    bool initWithTask(task_t owningTask, void* securityID, UInt32 type, OSDictionary* properties) override;
+    bool start(IOService* provider) override;
+    IOReturn clientClose() override;
+    IOReturn clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory) override;
+};
+
+#endif /* AMDMicrophoneUserClient_hpp */
@@ -0,0 +1,133 @@
+//
+//  AMDMicrophoneVAD.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneVAD_hpp
+#define AMDMicrophoneVAD_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+#define VAD_DECIMATION      4
+#define VAD_FRAME_SAMPLES   120
+#define VAD_ONSET_FRAMES    3
+#define VAD_HANGOVER_FRAMES 30
+#define VAD_ENERGY_RATIO    4.0f
+#define VAD_MIN_ENERGY      1e-9f
+#define VAD_MIN_CROSSINGS   4
+#define VAD_MAX_CROSSINGS   50
+#define VAD_DC_POLE         0.995f
+
+// Voice activity detector for the listening mode. It looks at every
+// VAD_DECIMATION-th frame of the ring, which is plenty for a speech/no-speech
+// decision and keeps the per-interrupt cost to a few hundred operations per
+// 10 ms. Each analysis frame of VAD_FRAME_SAMPLES samples (10 ms) is
+// classed as speech when its energy is VAD_ENERGY_RATIO above the tracked
+// noise floor and its zero-crossing count is in the voiced range, which
+// rejects fan rumble and hiss. Speech starts after VAD_ONSET_FRAMES such
+// frames in a row and ends after VAD_HANGOVER_FRAMES without one.
+class AMDMicrophoneVAD {
+    float dcInput = 0.0f;
+    float dcOutput = 0.0f;
+    float energy = 0.0f;
+    UInt32 crossings = 0;
+    UInt32 samples = 0;
+    UInt32 phase = 0;
+    UInt32 speechRun = 0;
+    UInt32 silenceRun = 0;
+
+    bool classify();
+
+public:
+    float noise = 0.0f;
+    bool speaking = false;
+
+    void reset();
+    bool process(const SInt32* ring, UInt32 ringFrames, UInt32 numChannels, UInt32 firstFrame, UInt32 numFrames);
+};
+
+inline void AMDMicrophoneVAD::reset()
+{
+    dcInput = 0.0f;
+    dcOutput = 0.0f;
+    energy = 0.0f;
+    crossings = 0;
+    samples = 0;
+    phase = 0;
+    speechRun = 0;
+    silenceRun = 0;
+    noise = 0.0f;
+    speaking = false;
+}
+
+// The noise floor falls quickly and rises slowly, and hardly at all during
+// speech, so it settles on the quiet parts of the signal.
+inline bool AMDMicrophoneVAD::classify()
+{
+    float level = energy / VAD_FRAME_SAMPLES;
+    bool voiced = crossings >= VAD_MIN_CROSSINGS && crossings <= VAD_MAX_CROSSINGS;
+    bool speech = noise > 0.0f && level > noise * VAD_ENERGY_RATIO && level > VAD_MIN_ENERGY && voiced;
+
+    if (noise == 0.0f)
+        noise = level;
+    else if (level < noise)
+        noise += (level - noise) * 0.2f;
+    else
+        noise += (level - noise) * (speech ? 0.001f : 0.01f);
+
+    energy = 0.0f;
+    crossings = 0;
+    samples = 0;
+
+    return speech;
+}
+
+// Analyses numFrames frames of the interleaved ring from firstFrame on,
+// wrapping at ringFrames. Returns true when speech starts.
+inline bool AMDMicrophoneVAD::process(
+    const SInt32* ring, UInt32 ringFrames, UInt32 numChannels, UInt32 firstFrame, UInt32 numFrames
+)
+{
+    const float scale = 1.0f / (2147483648.0f * numChannels);
+    bool started = false;
+    UInt32 offset;
+
+    for (offset = phase; offset < numFrames; offset += VAD_DECIMATION) {
+        const SInt32* frame = &ring[((firstFrame + offset) % ringFrames) * numChannels];
+        float input = 0.0f, output;
+
+        for (UInt32 channel = 0; channel < numChannels; channel++)
+            input += (float)frame[channel];
+        input *= scale;
+
+        // One-pole DC blocker, so a PDM offset does not hide zero crossings.
+        output = input - dcInput + VAD_DC_POLE * dcOutput;
+        if ((output < 0.0f) != (dcOutput < 0.0f))
+            crossings++;
+        dcInput = input;
+        dcOutput = output;
+        energy += output * output;
+
+        if (++samples < VAD_FRAME_SAMPLES)
+            continue;
+
+        if (classify()) {
+            silenceRun = 0;
+            if (++speechRun >= VAD_ONSET_FRAMES && !speaking) {
+                speaking = true;
+                started = true;
+            }
+        } else {
+            speechRun = 0;
+            if (speaking && ++silenceRun >= VAD_HANGOVER_FRAMES)
+                speaking = false;
+        }
+    }
+    phase = offset - numFrames;
+
+    return started;
+}
+
+#endif /* AMDMicrophoneVAD_hpp */
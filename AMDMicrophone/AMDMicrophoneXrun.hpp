@@ -0,0 +1,84 @@
+//
+//  AMDMicrophoneXrun.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneXrun_hpp
+#define AMDMicrophoneXrun_hpp
+
+#include "AMDMicrophoneTypes.hpp"
+
+// Checks the DMA write position against what the engine reads, at 48 kHz
+// frames counted from DMA start.
+//
+// interrupt() runs on every watermark with the exact position; it counts
+// missed watermarks and notices when DMA has overwritten frames the engine
+// has not read yet. read() runs on every conversion with the predicted
+// position; it catches reads that reach past the write head. The two run on
+// different threads and share only atomics.
+class AMDMicrophoneXrun {
+    UInt32 ringFrames = 1;
+    UInt32 periodFrames = 1;
+    UInt64 lastInterruptFrame = 0;
+    bool haveInterrupt = false;
+    UInt64 readEnd = 0;
+    bool lapped = false;
+
+public:
+    UInt64 overruns = 0;
+    UInt64 missedInterrupts = 0;
+
+    void configure(UInt32 frames, UInt32 framesPerPeriod);
+    void interrupt(UInt64 frame);
+    bool read(UInt64 writeFrame, UInt32 firstFrame, UInt32 numFrames);
+};
+
+inline void AMDMicrophoneXrun::configure(UInt32 frames, UInt32 framesPerPeriod)
+{
+    ringFrames = frames;
+    periodFrames = framesPerPeriod;
+    haveInterrupt = false;
+    __atomic_store_n(&readEnd, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&lapped, false, __ATOMIC_RELAXED);
+}
+
+// A gap of more than one and a half periods since the last watermark counts
+// the periods in between as missed.
+inline void AMDMicrophoneXrun::interrupt(UInt64 frame)
+{
+    UInt64 end = __atomic_load_n(&readEnd, __ATOMIC_ACQUIRE);
+
+    if (haveInterrupt && frame - lastInterruptFrame > periodFrames + periodFrames / 2) {
+        __atomic_fetch_add(
+            &missedInterrupts, (frame - lastInterruptFrame + periodFrames / 2) / periodFrames - 1, __ATOMIC_RELAXED
+        );
+    }
+    lastInterruptFrame = frame;
+    haveInterrupt = true;
+
+    if (end && frame > end + ringFrames && !__atomic_exchange_n(&lapped, true, __ATOMIC_ACQ_REL))
+        __atomic_fetch_add(&overruns, 1, __ATOMIC_RELAXED);
+}
+
+// firstFrame is the ring index of the read. It is placed at the most recent
+// pass of the write head; if the head sits inside the frames being read,
+// part of them is stale or not written yet. Returns true if frames of this
+// read, or unread frames before it, were lost.
+inline bool AMDMicrophoneXrun::read(UInt64 writeFrame, UInt32 firstFrame, UInt32 numFrames)
+{
+    UInt64 behind = (writeFrame % ringFrames + ringFrames - firstFrame % ringFrames) % ringFrames;
+    bool lost = __atomic_exchange_n(&lapped, false, __ATOMIC_ACQ_REL);
+
+    if (behind < numFrames) {
+        __atomic_fetch_add(&overruns, 1, __ATOMIC_RELAXED);
+        lost = true;
+    }
+    if (behind <= writeFrame)
+        __atomic_store_n(&readEnd, writeFrame - behind + numFrames, __ATOMIC_RELEASE);
+
+    return lost;
+}
+
+#endif /* AMDMicrophoneXrun_hpp */
@@ -0,0 +1,210 @@
+//
+//  AMDMicrophoneBench.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+// Times AMDMicrophoneDSP::process() for every client format the engine
+// publishes, mono and stereo in float and 16-bit, on three synthetic
+// inputs and several convert sizes, through the float and the fixed-point
+// pipeline and through the float pipeline with the noise suppressor on. The
+// last column is the time each case adds to the plain float pipeline, so
+// the suppress rows give the suppressor's own cost. The ring is filled once and the calls walk it as the engine's
+// convertInputSamples() does, so only the processing is timed. Each case
+// runs a second of audio first, past the startup fade, and reports the best
+// of its repeats.
+//
+//   c++ -std=c++17 -O2 -msse2 -I AMDMicrophone Tools/AMDMicrophoneBench.cpp -o bench
+//   ./bench [-f frames per repeat] [-r repeats] [-p float|fixed|suppress]
+//
+// silence is digital zero, which the silence skip short-cuts; full-scale
+// is a 1 kHz sine at full scale, which the software gain drives into the
+// clamp; noise is white noise at -24 dBFS.
+
+#include "AMDMicrophoneDSP.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Engine defaults, see AMDMicrophoneEngine.hpp.
+#define RING_BYTES       61440
+#define CAPTURE_CHANNELS 2
+
+#define BENCH_FRAMES  480000
+#define BENCH_REPEATS 5
+
+// NoiseSuppressionFloor of the suppress pipeline.
+#define BENCH_SUPPRESSION_FLOOR 0.1f
+
+enum Input {
+    kInputSilence,
+    kInputFullScale,
+    kInputNoise,
+};
+
+static const char* const inputNames[] = { "silence", "full-scale", "noise" };
+
+static const struct {
+    UInt32 channels;
+    UInt32 bitWidth;
+    const char* name;
+} formats[] = {
+    { 1, 32, "mono float" },
+    { 2, 32, "stereo float" },
+    { 1, 16, "mono 16-bit" },
+    { 2, 16, "stereo 16-bit" },
+};
+
+static const UInt32 blockFrames[] = { 64, 256, 512, 1024 };
+
+enum Pipeline {
+    kPipelineFloat,
+    kPipelineFixed,
+    kPipelineSuppress,
+    kPipelineCount,
+};
+
+static const char* const pipelineNames[] = { "float", "fixed", "suppress" };
+
+struct Options {
+    UInt64 frames = BENCH_FRAMES;
+    UInt32 repeats = BENCH_REPEATS;
+    // Both pipelines unless one is named.
+    const char* pipeline = NULL;
+};
+
+static double seconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void fillRing(SInt32* ring, UInt32 ringFrames, Input input)
+{
+    UInt32 state = 1;
+
+    for (UInt32 frame = 0; frame < ringFrames; frame++) {
+        for (UInt32 channel = 0; channel < CAPTURE_CHANNELS; channel++) {
+            SInt32* sample = &ring[frame * CAPTURE_CHANNELS + channel];
+
+            if (input == kInputSilence)
+                *sample = 0;
+            else if (input == kInputFullScale)
+                *sample = (SInt32)(2147483647.0 * sin(2.0 * M_PI * 1000.0 * frame / SAMPLE_RATE));
+            else {
+                state = state * 1664525 + 1013904223;
+                *sample = (SInt32)state >> 4;
+            }
+        }
+    }
+}
+
+// Client frames processed from firstFrame on, in convert calls of count
+// frames split where the ring wraps.
+static void run(AMDMicrophoneDSP& dsp, const SInt32* ring, UInt32 ringFrames, void* output, UInt32 channels,
+    UInt32 bitWidth, UInt32 count, UInt64 frames)
+{
+    for (UInt64 done = 0; done < frames;) {
+        UInt32 firstFrame = (UInt32)(done % ringFrames);
+        UInt32 numFrames = count < ringFrames - firstFrame ? count : ringFrames - firstFrame;
+
+        dsp.process(ring, ringFrames, firstFrame, output, numFrames, channels, bitWidth);
+        done += numFrames;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static AMDMicrophoneDSP dsp;
+    Options options;
+    UInt32 ringFrames = RING_BYTES / (CAPTURE_CHANNELS * 4);
+    SInt32* ring = (SInt32*)calloc(ringFrames, CAPTURE_CHANNELS * 4);
+    float* output = (float*)calloc(blockFrames[sizeof(blockFrames) / sizeof(blockFrames[0]) - 1], 2 * sizeof(float));
+    float delays[RESAMPLER_MAX_CHANNELS] = {};
+    // ns per frame of the float pipeline, by format, input and convert size.
+    static double floatTimes[sizeof(formats) / sizeof(formats[0])][kInputNoise + 1]
+                            [sizeof(blockFrames) / sizeof(blockFrames[0])];
+    int option;
+
+    while ((option = getopt(argc, argv, "f:r:p:")) != -1) {
+        switch (option) {
+        case 'f':
+            options.frames = strtoull(optarg, NULL, 0);
+            break;
+        case 'r':
+            options.repeats = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            options.pipeline = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-f frames per repeat] [-r repeats] [-p float|fixed|suppress]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!ring || !output || !options.frames || !options.repeats)
+        return 1;
+
+    dsp.resampler.setChannels(CAPTURE_CHANNELS, delays);
+    dsp.resampler.configure(SAMPLE_RATE);
+
+    printf("%-8s %-14s %-11s %6s %10s %14s %10s\n", "pipeline", "format", "input", "frames", "ns/frame", "frames/s",
+        "vs float");
+
+    for (UInt32 pipeline = kPipelineFloat; pipeline < kPipelineCount; pipeline++) {
+        AMDMicrophoneDSPParameters parameters;
+
+        if (options.pipeline && strcmp(options.pipeline, pipelineNames[pipeline]))
+            continue;
+        if (pipeline == kPipelineSuppress)
+            parameters.suppressionFloor = BENCH_SUPPRESSION_FLOOR;
+        dsp.fixedPoint = pipeline == kPipelineFixed;
+        dsp.setParameters(parameters);
+
+        for (UInt32 formatIndex = 0; formatIndex < sizeof(formats) / sizeof(formats[0]); formatIndex++) {
+            const auto& format = formats[formatIndex];
+
+            for (UInt32 input = kInputSilence; input <= kInputNoise; input++) {
+                fillRing(ring, ringFrames, (Input)input);
+
+                for (UInt32 countIndex = 0; countIndex < sizeof(blockFrames) / sizeof(blockFrames[0]); countIndex++) {
+                    UInt32 count = blockFrames[countIndex];
+                    double* floatTime = &floatTimes[formatIndex][input][countIndex];
+                    double best = 0, nanoseconds;
+
+                    dsp.reset();
+                    run(dsp, ring, ringFrames, output, format.channels, format.bitWidth, count, SAMPLE_RATE);
+
+                    for (UInt32 repeat = 0; repeat < options.repeats; repeat++) {
+                        double start = seconds(), elapsed;
+
+                        run(dsp, ring, ringFrames, output, format.channels, format.bitWidth, count, options.frames);
+                        elapsed = seconds() - start;
+                        if (!repeat || elapsed < best)
+                            best = elapsed;
+                    }
+
+                    nanoseconds = best * 1e9 / options.frames;
+                    printf("%-8s %-14s %-11s %6u %10.2f %14.0f", pipelineNames[pipeline], format.name,
+                        inputNames[input], count, nanoseconds, options.frames / best);
+                    if (pipeline == kPipelineFloat)
+                        *floatTime = nanoseconds;
+                    else if (*floatTime)
+                        printf(" %+10.2f", nanoseconds - *floatTime);
+                    printf("\n");
+                }
+            }
+        }
+    }
+
+    free(output);
+    free(ring);
+    return 0;
+}
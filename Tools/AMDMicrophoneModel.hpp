@@ -0,0 +1,274 @@
+//
+//  AMDMicrophoneModel.hpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+#ifndef AMDMicrophoneModel_hpp
+#define AMDMicrophoneModel_hpp
+
+#include "AMDMicrophoneACP.hpp"
+
+#include <string.h>
+
+#define MODEL_SAMPLE_RATE         48000
+#define ACP_POWER_OFF_IN_PROGRESS 0x3
+
+// Software model of the ACP PDM block behind the AMDMicrophoneACP Bus
+// interface, for driving the register code on a host. It keeps its own
+// clock in nanoseconds, which register accesses and delays advance, so
+// every run is repeatable and its timings are those of the model, not of
+// the host. The latencies are estimates; set them to explore other chips.
+//
+// Modelled: the PGFSM power states, soft reset with its AUDDONE handshake,
+// the PDM and DMA enables with the DMA status handshake, and the linear
+// position counter, which advances at 48 kHz from the moment the DMA status
+// latches. The ring set up by initRingBuffer() is filled through the ATU and
+// the PTEs, which hold host addresses here, with frame * channels + channel
+// as the sample value. The watermark interrupt latches in
+// EXTERNAL_INTR_STAT and asserts while it is enabled. Powering off loses
+// every register but the PGFSM; a soft reset stops the DMA and clears the
+// ring and PTE setup.
+template <typename Map = AMDMicrophoneRenoir>
+class AMDMicrophoneModel {
+    UInt32 regs[Map::size / 4] = {};
+
+    UInt32 pgfsmTarget = ACP_POWERED_OFF;
+    UInt64 pgfsmDone = 0;
+    bool resetting = false;
+    UInt64 resetDone = 0;
+    bool dmaSwitching = false;
+    bool dmaTarget = false;
+    UInt64 dmaSwitched = 0;
+    bool streaming = false;
+    UInt64 streamStart = 0;
+    UInt64 streamFrames = 0;
+    UInt32 ringOffset = 0;
+    UInt32 watermarkOffset = 0;
+
+    UInt32& reg(UInt32 offset) { return regs[(offset - Map::base) / 4]; }
+    bool isPoweredOn() { return reg(Map::pgfsmStatus) == 0; }
+    UInt32 channels() { return reg(Map::wovPdmChannels) == ACP_PDM_CHANNELS_4 ? 4 : 2; }
+    void settle();
+    void stream();
+    void writeFrame(UInt64 frame, UInt32 frameBytes);
+    void clearBlock();
+
+public:
+    UInt64 now = 0;
+    UInt32 readNanoseconds = 1000;
+    UInt32 writeNanoseconds = 100;
+    UInt32 relaxNanoseconds = 20;
+    UInt32 powerNanoseconds = 50000;
+    UInt32 resetNanoseconds = 10000;
+    UInt32 dmaNanoseconds = 3000;
+
+    // Accesses the block dropped because it was powered off, and ring
+    // writes that found no valid PTE.
+    UInt64 offAccesses = 0;
+    UInt64 dmaFaults = 0;
+
+    AMDMicrophoneModel() { reg(Map::pgfsmStatus) = ACP_POWERED_OFF; }
+
+    void advance(UInt64 nanoseconds)
+    {
+        now += nanoseconds;
+        settle();
+        stream();
+    }
+
+    bool isInterruptAsserted()
+    {
+        return (reg(Map::externalIntrStat) & BIT(Map::pdmDmaStat)) && (reg(Map::externalIntrEnb) & 0x1)
+            && (reg(Map::externalIntrCntl) & ACP_PDM_DMA_INTR_MASK);
+    }
+
+    // Nanoseconds until the next watermark interrupt, or 0 if none is due.
+    UInt64 nextInterrupt();
+
+    // Model time the given frame of the current stream reaches the ring.
+    UInt64 frameTime(UInt64 frame) const
+    {
+        return streamStart + ((frame + 1) * 1000000000 + MODEL_SAMPLE_RATE - 1) / MODEL_SAMPLE_RATE;
+    }
+
+    UInt32 readl(UInt32 offset);
+    void writel(UInt32 val, UInt32 offset);
+    void delay(UInt32 us) { advance((UInt64)us * 1000); }
+    void relax() { advance(relaxNanoseconds); }
+};
+
+template <typename Map>
+void AMDMicrophoneModel<Map>::clearBlock()
+{
+    UInt32 pgfsmStatus = reg(Map::pgfsmStatus);
+    UInt32 control = reg(Map::control);
+    UInt32 softReset = reg(Map::softReset);
+
+    memset(regs, 0, sizeof(regs));
+    reg(Map::pgfsmStatus) = pgfsmStatus;
+    reg(Map::control) = control;
+    reg(Map::softReset) = softReset;
+    streaming = false;
+    dmaSwitching = false;
+}
+
+template <typename Map>
+void AMDMicrophoneModel<Map>::settle()
+{
+    if (reg(Map::pgfsmStatus) != pgfsmTarget && now >= pgfsmDone) {
+        reg(Map::pgfsmStatus) = pgfsmTarget;
+        if (pgfsmTarget == ACP_POWERED_OFF) {
+            clearBlock();
+            reg(Map::control) = 0;
+            reg(Map::softReset) = 0;
+        }
+    }
+
+    if (resetting && now >= resetDone) {
+        reg(Map::softReset) |= ACP_SOFT_RESET_SOFTRESET_AUDDONE_MASK & ~0x1;
+        resetting = false;
+    }
+
+    if (dmaSwitching && now >= dmaSwitched) {
+        dmaSwitching = false;
+        if (dmaTarget && reg(Map::wovPdmEnable) == 0x1) {
+            reg(Map::wovPdmDmaEnable) |= ACP_PDM_DMA_EN_STATUS;
+            streaming = true;
+            streamStart = dmaSwitched;
+            streamFrames = 0;
+            ringOffset = 0;
+            watermarkOffset = 0;
+        } else if (!dmaTarget) {
+            reg(Map::wovPdmDmaEnable) &= ~ACP_PDM_DMA_EN_STATUS;
+            streaming = false;
+        }
+    }
+}
+
+template <typename Map>
+void AMDMicrophoneModel<Map>::writeFrame(UInt64 frame, UInt32 frameBytes)
+{
+    UInt32 windowOffset = reg(Map::wovRxRingbufAddr) - ACP_MEM_WINDOW_START + ringOffset;
+    UInt32 page = windowOffset / ACP_DMA_PAGE_SIZE;
+    UInt32 low, high;
+    UInt32* samples;
+
+    // The ATU has to point at the PTEs in the scratch SRAM.
+    if (reg(Map::atuBaseAddrGrp1) != (Map::sramPteOffset | BIT(31)) || reg(Map::atuCtrl) != 0x1
+        || (page + 1) * 8 > ACP_PTE_WINDOW) {
+        dmaFaults++;
+        return;
+    }
+
+    low = reg(Map::scratchReg0 + page * 8);
+    high = reg(Map::scratchReg0 + page * 8 + 4);
+    if (!(high & BIT(31))) {
+        dmaFaults++;
+        return;
+    }
+
+    samples = (UInt32*)(uintptr_t)(((UInt64)(high & ~BIT(31)) << 32 | low) + windowOffset % ACP_DMA_PAGE_SIZE);
+    for (UInt32 channel = 0; channel < frameBytes / 4; channel++)
+        samples[channel] = (UInt32)(frame * (frameBytes / 4) + channel);
+}
+
+template <typename Map>
+void AMDMicrophoneModel<Map>::stream()
+{
+    UInt32 frameBytes = channels() * 4;
+    UInt32 ringSize = reg(Map::wovRxRingbufSize);
+    UInt32 watermark = reg(Map::wovRxWatermarkSize);
+    UInt64 frames;
+
+    if (!streaming || !ringSize)
+        return;
+
+    frames = (now - streamStart) * MODEL_SAMPLE_RATE / 1000000000;
+    while (streamFrames < frames) {
+        UInt64 position = ((UInt64)reg(Map::wovRxPositionHigh) << 32 | reg(Map::wovRxPositionLow)) + frameBytes;
+
+        writeFrame(streamFrames++, frameBytes);
+        reg(Map::wovRxPositionHigh) = (UInt32)(position >> 32);
+        reg(Map::wovRxPositionLow) = (UInt32)position;
+
+        ringOffset = (ringOffset + frameBytes) % ringSize;
+        watermarkOffset += frameBytes;
+        if (watermark && watermarkOffset >= watermark) {
+            watermarkOffset -= watermark;
+            reg(Map::externalIntrStat) |= BIT(Map::pdmDmaStat);
+        }
+    }
+}
+
+template <typename Map>
+UInt64 AMDMicrophoneModel<Map>::nextInterrupt()
+{
+    UInt32 frameBytes = channels() * 4;
+    UInt32 watermark = reg(Map::wovRxWatermarkSize);
+    UInt64 frame;
+
+    if (!streaming || !watermark)
+        return 0;
+
+    frame = streamFrames + (watermark - watermarkOffset + frameBytes - 1) / frameBytes;
+    return streamStart + (frame * 1000000000 + MODEL_SAMPLE_RATE - 1) / MODEL_SAMPLE_RATE - now;
+}
+
+template <typename Map>
+UInt32 AMDMicrophoneModel<Map>::readl(UInt32 offset)
+{
+    advance(readNanoseconds);
+
+    if (offset != Map::pgfsmStatus && !isPoweredOn()) {
+        offAccesses++;
+        return 0;
+    }
+
+    return reg(offset);
+}
+
+template <typename Map>
+void AMDMicrophoneModel<Map>::writel(UInt32 val, UInt32 offset)
+{
+    advance(writeNanoseconds);
+
+    if (offset == Map::pgfsmControl) {
+        pgfsmTarget = val & ACP_PGFSM_CNTL_POWER_ON_MASK ? 0 : ACP_POWERED_OFF;
+        if (reg(Map::pgfsmStatus) != pgfsmTarget) {
+            reg(Map::pgfsmStatus) = pgfsmTarget ? ACP_POWER_OFF_IN_PROGRESS : ACP_POWER_ON_IN_PROGRESS;
+            pgfsmDone = now + powerNanoseconds;
+        }
+        return;
+    }
+
+    if (!isPoweredOn()) {
+        offAccesses++;
+        return;
+    }
+
+    if (offset == Map::softReset) {
+        if (val & 0x1) {
+            clearBlock();
+            reg(Map::softReset) = 0x1;
+            resetting = true;
+            resetDone = now + resetNanoseconds;
+        } else {
+            reg(Map::softReset) = 0;
+            resetting = false;
+        }
+    } else if (offset == Map::externalIntrStat)
+        reg(offset) &= ~val;
+    else if (offset == Map::wovPdmDmaEnable) {
+        reg(offset) = (reg(offset) & ACP_PDM_DMA_EN_STATUS) | (val & 0x1);
+        dmaTarget = val & 0x1;
+        dmaSwitching = true;
+        dmaSwitched = now + dmaNanoseconds;
+    } else if (offset == Map::wovPdmFifoFlush)
+        reg(offset) = 0;
+    else if (offset != Map::pgfsmStatus && offset != Map::wovRxPositionHigh && offset != Map::wovRxPositionLow)
+        reg(offset) = val;
+}
+
+#endif /* AMDMicrophoneModel_hpp */
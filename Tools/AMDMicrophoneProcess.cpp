@@ -0,0 +1,392 @@
+//
+//  AMDMicrophoneProcess.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+// Runs the engine's capture processing over a recording, for repeatable
+// tuning and batch processing of field captures. The input is a raw or WAV
+// stream of 32-bit PCM frames at 48 kHz, as the DMA ring holds them. It is
+// copied into a ring of the engine's size a little ahead of the reads, and
+// AMDMicrophoneDSP::process() is called the way IOAudioFamily calls
+// convertInputSamples(): fixed-size chunks at client ring positions, split
+// where the ring wraps. The DSP state machine (fade, expander, high-pass,
+// suppressor, resampler) therefore runs exactly as in the kext.
+//
+// Input and output are memory-mapped. With -g the output is compared bit
+// for bit against a golden file instead of being written. The smoothing
+// steps once per block, so a golden file holds only for the options it was
+// made with, -n included.
+//
+//   c++ -std=c++17 -O2 -msse2 -I AMDMicrophone Tools/AMDMicrophoneProcess.cpp -o process
+//   ./process [options] input.wav output.wav
+//   ./process [options] -g golden.wav input.wav
+
+#include "AMDMicrophoneDSP.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Engine defaults, see AMDMicrophoneEngine.hpp.
+#define RING_BYTES    61440
+#define PERIOD_FRAMES 960
+#define CHUNK_FRAMES  512
+#define WAV_HEADER    44
+
+struct Options {
+    UInt32 captureChannels = 2;
+    UInt32 outputChannels = 2;
+    UInt32 bitWidth = 32;
+    UInt32 rate = SAMPLE_RATE;
+    UInt32 chunkFrames = CHUNK_FRAMES;
+    UInt32 ringBytes = RING_BYTES;
+    bool fixedPoint = false;
+    bool wav = false;
+    AMDMicrophoneDSPParameters parameters;
+    const char* golden = NULL;
+};
+
+struct Mapping {
+    UInt8* bytes = NULL;
+    size_t size = 0;
+};
+
+static void usage(const char* name)
+{
+    fprintf(
+        stderr,
+        "usage: %s [options] input output\n"
+        "       %s [options] -g golden input\n"
+        "  -c 2|4        capture channels of a raw input (default 2)\n"
+        "  -m 1|2        output channels (default 2)\n"
+        "  -b 32|16      output bits: 32 is float, 16 is integer (default 32)\n"
+        "  -r rate       output sample rate (default 48000)\n"
+        "  -n frames     client frames per convert call (default 512)\n"
+        "  -s bytes      DMA ring size, at least two periods and a chunk (default 61440)\n"
+        "  -x            fixed-point pipeline\n"
+        "  -t key=value  tunable in thousandths, as in Info.plist\n"
+        "  -w            write a WAV header (implied by a WAV input)\n",
+        name, name
+    );
+}
+
+static bool setTunable(AMDMicrophoneDSPParameters* parameters, const char* assignment)
+{
+    const char* equals = strchr(assignment, '=');
+
+    for (UInt32 index = 0; equals && index < sizeof(dspTunables) / sizeof(dspTunables[0]); index++) {
+        unsigned long value;
+
+        if (strlen(dspTunables[index].key) != (size_t)(equals - assignment)
+            || strncmp(dspTunables[index].key, assignment, equals - assignment))
+            continue;
+
+        value = strtoul(equals + 1, NULL, 10);
+        if (value < dspTunables[index].minimum || value > dspTunables[index].maximum)
+            return false;
+        parameters->*dspTunables[index].member = value / 1000.0f;
+        return true;
+    }
+
+    return false;
+}
+
+static bool mapInput(const char* path, Mapping* mapping)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) || !info.st_size) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    mapping->size = info.st_size;
+    mapping->bytes = (UInt8*)mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping->bytes == MAP_FAILED)
+        return false;
+
+    madvise(mapping->bytes, mapping->size, MADV_SEQUENTIAL);
+    return true;
+}
+
+// A NULL path gives anonymous memory, for the compare mode.
+static bool mapOutput(const char* path, size_t size, Mapping* mapping)
+{
+    int fd = -1;
+
+    if (path) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, size)) {
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+    }
+
+    mapping->size = size;
+    mapping->bytes = (UInt8*)mmap(
+        NULL, size, PROT_READ | PROT_WRITE, path ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS, fd, 0
+    );
+    if (fd >= 0)
+        close(fd);
+
+    return mapping->bytes != MAP_FAILED;
+}
+
+static UInt32 readLE(const UInt8* bytes, UInt32 size)
+{
+    UInt32 value = 0;
+
+    for (UInt32 index = 0; index < size; index++)
+        value |= (UInt32)bytes[index] << (8 * index);
+
+    return value;
+}
+
+static void writeLE(UInt8* bytes, UInt32 value, UInt32 size)
+{
+    for (UInt32 index = 0; index < size; index++)
+        bytes[index] = (UInt8)(value >> (8 * index));
+}
+
+// Finds the sample data of a 32-bit integer PCM WAV at 48 kHz.
+static bool parseWAV(const Mapping& input, Options* options, size_t* offset, size_t* size)
+{
+    size_t position = 12;
+    bool format = false;
+
+    if (input.size < 12 || memcmp(input.bytes, "RIFF", 4) || memcmp(input.bytes + 8, "WAVE", 4))
+        return false;
+
+    while (position + 8 <= input.size) {
+        const UInt8* chunk = input.bytes + position;
+        size_t length = readLE(chunk + 4, 4);
+
+        if (!memcmp(chunk, "fmt ", 4) && length >= 16 && position + 8 + length <= input.size) {
+            UInt32 tag = readLE(chunk + 8, 2);
+
+            if (tag == 0xFFFE && length >= 26)
+                tag = readLE(chunk + 32, 2);
+            if (tag != 1 || readLE(chunk + 12, 4) != SAMPLE_RATE || readLE(chunk + 22, 2) != 32)
+                return false;
+            options->captureChannels = readLE(chunk + 10, 2);
+            format = true;
+        } else if (!memcmp(chunk, "data", 4) && format) {
+            *offset = position + 8;
+            *size = length < input.size - *offset ? length : input.size - *offset;
+            return true;
+        }
+        position += 8 + length + (length & 1);
+    }
+
+    return false;
+}
+
+static void writeWAVHeader(UInt8* header, const Options& options, UInt64 dataBytes)
+{
+    UInt32 bytesPerFrame = options.outputChannels * options.bitWidth / 8;
+
+    memcpy(header, "RIFF", 4);
+    writeLE(header + 4, (UInt32)(WAV_HEADER - 8 + dataBytes), 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    writeLE(header + 16, 16, 4);
+    writeLE(header + 20, options.bitWidth == 32 ? 3 : 1, 2);
+    writeLE(header + 22, options.outputChannels, 2);
+    writeLE(header + 24, options.rate, 4);
+    writeLE(header + 28, options.rate * bytesPerFrame, 4);
+    writeLE(header + 32, bytesPerFrame, 2);
+    writeLE(header + 34, options.bitWidth, 2);
+    memcpy(header + 36, "data", 4);
+    writeLE(header + 40, (UInt32)dataBytes, 4);
+}
+
+static double seconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+    static AMDMicrophoneDSP dsp;
+    Options options;
+    Mapping input, output, golden;
+    size_t dataOffset = 0, dataSize;
+    UInt64 inputFrames, outputFrames, written = 0, calls = 0;
+    UInt32 ringFrames, minimumFrames, clientRingFrames, headerBytes, outputFrameBytes;
+    SInt32* ring;
+    float delays[RESAMPLER_MAX_CHANNELS] = {};
+    double start, elapsed;
+    int option;
+
+    while ((option = getopt(argc, argv, "c:m:b:r:n:s:xt:wg:")) != -1) {
+        switch (option) {
+        case 'c':
+            options.captureChannels = atoi(optarg);
+            break;
+        case 'm':
+            options.outputChannels = atoi(optarg);
+            break;
+        case 'b':
+            options.bitWidth = atoi(optarg);
+            break;
+        case 'r':
+            options.rate = atoi(optarg);
+            break;
+        case 'n':
+            options.chunkFrames = atoi(optarg);
+            break;
+        case 's':
+            options.ringBytes = atoi(optarg);
+            break;
+        case 'x':
+            options.fixedPoint = true;
+            break;
+        case 't':
+            if (!setTunable(&options.parameters, optarg)) {
+                fprintf(stderr, "bad tunable %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'w':
+            options.wav = true;
+            break;
+        case 'g':
+            options.golden = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc - optind != (options.golden ? 1 : 2)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!mapInput(argv[optind], &input)) {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    dataSize = input.size;
+    if (parseWAV(input, &options, &dataOffset, &dataSize))
+        options.wav = true;
+    else if (!memcmp(input.bytes, "RIFF", 4)) {
+        fprintf(stderr, "%s is not a 48 kHz 32-bit integer WAV\n", argv[optind]);
+        return 1;
+    }
+
+    if ((options.captureChannels != 2 && options.captureChannels != 4)
+        || (options.outputChannels != 1 && options.outputChannels != 2)
+        || (options.bitWidth != 16 && options.bitWidth != 32) || !options.chunkFrames
+        || options.ringBytes % (options.captureChannels * 4)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    dsp.resampler.setChannels(options.captureChannels, delays);
+    if (!dsp.resampler.configure(options.rate)) {
+        fprintf(stderr, "unsupported output rate %u\n", options.rate);
+        return 2;
+    }
+    dsp.fixedPoint = options.fixedPoint;
+    dsp.setParameters(options.parameters);
+    dsp.reset();
+
+    // The copy runs two periods ahead of a chunk's last frame while the
+    // filter still reads its history before the first, so a smaller ring
+    // would be overwritten under the read.
+    ringFrames = options.ringBytes / (options.captureChannels * 4);
+    minimumFrames = 2 * PERIOD_FRAMES + (UInt32)dsp.resampler.toInputFrames(options.chunkFrames) + 1 + RESAMPLER_MAX_TAPS;
+    if (ringFrames < minimumFrames) {
+        fprintf(
+            stderr, "-s %u is too small: -n %u needs at least %u bytes\n", options.ringBytes, options.chunkFrames,
+            minimumFrames * options.captureChannels * 4
+        );
+        return 2;
+    }
+    clientRingFrames = dsp.resampler.toOutputFrames(ringFrames);
+    ring = (SInt32*)calloc(ringFrames, options.captureChannels * 4);
+    inputFrames = dataSize / (options.captureChannels * 4);
+    outputFrames = inputFrames * options.rate / RESAMPLER_INPUT_RATE;
+    outputFrameBytes = options.outputChannels * options.bitWidth / 8;
+    headerBytes = options.wav ? WAV_HEADER : 0;
+
+    if (!ring || !outputFrames || !mapOutput(options.golden ? NULL : argv[optind + 1], headerBytes + outputFrames * outputFrameBytes, &output)) {
+        fprintf(stderr, "cannot create the output\n");
+        return 1;
+    }
+    if (options.wav)
+        writeWAVHeader(output.bytes, options, outputFrames * outputFrameBytes);
+
+    start = seconds();
+    for (UInt64 done = 0; done < outputFrames;) {
+        UInt32 firstFrame = (UInt32)(done % clientRingFrames);
+        UInt32 count = outputFrames - done < options.chunkFrames ? (UInt32)(outputFrames - done) : options.chunkFrames;
+        UInt64 needed = dsp.resampler.toInputFrames(done + count) + 2 * PERIOD_FRAMES;
+
+        // The DMA runs two periods ahead of the reads, like the engine's
+        // input sample offset.
+        for (; written < needed; written++) {
+            SInt32* slot = &ring[(written % ringFrames) * options.captureChannels];
+
+            if (written < inputFrames)
+                memcpy(slot, input.bytes + dataOffset + written * options.captureChannels * 4, options.captureChannels * 4);
+            else
+                memset(slot, 0, options.captureChannels * 4);
+        }
+
+        if (count > clientRingFrames - firstFrame)
+            count = clientRingFrames - firstFrame;
+
+        dsp.process(
+            ring, ringFrames, firstFrame, output.bytes + headerBytes + done * outputFrameBytes, count,
+            options.outputChannels, options.bitWidth
+        );
+        done += count;
+        calls++;
+    }
+    elapsed = seconds() - start;
+
+    fprintf(
+        stderr, "%llu frames in %llu calls, %.3f s: %.3f GB/s, %.0fx real time\n", (unsigned long long)inputFrames,
+        (unsigned long long)calls, elapsed, dataSize / elapsed / 1e9, inputFrames / (double)SAMPLE_RATE / elapsed
+    );
+
+    if (options.golden) {
+        if (!mapInput(options.golden, &golden)) {
+            fprintf(stderr, "cannot read %s\n", options.golden);
+            return 1;
+        }
+        if (golden.size != output.size) {
+            printf("size differs: %zu bytes, golden %zu\n", output.size, golden.size);
+            return 1;
+        }
+        if (memcmp(output.bytes, golden.bytes, output.size)) {
+            size_t offset = 0;
+
+            while (output.bytes[offset] == golden.bytes[offset])
+                offset++;
+            printf(
+                "differs at byte %zu, output frame %llu\n", offset,
+                (unsigned long long)(offset < headerBytes ? 0 : (offset - headerBytes) / outputFrameBytes)
+            );
+            return 1;
+        }
+        printf("matches %s\n", options.golden);
+    }
+
+    return 0;
+}
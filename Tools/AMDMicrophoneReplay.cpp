@@ -0,0 +1,374 @@
+//
+//  AMDMicrophoneReplay.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+// Offline companion of the register trace. On macOS it saves the live trace
+// of the loaded kext to a file, with the TSC rate measured; on any host it
+// prints a saved trace and replays every traced entry point through the
+// driver's own ACP code, checking that the code issues exactly the recorded
+// register sequence and that its delays took at least as long as asked.
+//
+//   c++ -std=c++17 -O2 -I AMDMicrophone Tools/AMDMicrophoneReplay.cpp -o replay
+//   ./replay dump trace.bin      (macOS, add -framework IOKit)
+//   ./replay show trace.bin
+//   ./replay check trace.bin
+
+#include "AMDMicrophoneACP.hpp"
+#include "AMDMicrophoneShadow.hpp"
+#include "AMDMicrophoneTap.hpp"
+#include "AMDMicrophoneTrace.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <IOKit/IOKitLib.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef AMDMicrophoneACP<AMDMicrophoneShadow<AMDMicrophoneTraceReplay<>>> ReplayACP;
+
+static const struct {
+    UInt32 reg;
+    const char* name;
+} registerNames[] = {
+    { ACP_AXI2AXI_ATU_PAGE_SIZE_GRP_1, "ATU_PAGE_SIZE_GRP_1" },
+    { ACP_AXI2AXI_ATU_BASE_ADDR_GRP_1, "ATU_BASE_ADDR_GRP_1" },
+    { ACP_AXI2AXI_ATU_CTRL, "ATU_CTRL" },
+    { ACP_SOFT_RESET, "SOFT_RESET" },
+    { ACP_CONTROL, "CONTROL" },
+    { ACP_EXTERNAL_INTR_ENB, "EXTERNAL_INTR_ENB" },
+    { ACP_EXTERNAL_INTR_CNTL, "EXTERNAL_INTR_CNTL" },
+    { ACP_EXTERNAL_INTR_STAT, "EXTERNAL_INTR_STAT" },
+    { ACP_PGFSM_CONTROL, "PGFSM_CONTROL" },
+    { ACP_PGFSM_STATUS, "PGFSM_STATUS" },
+    { ACP_CLKMUX_SEL, "CLKMUX_SEL" },
+    { ACP_WOV_PDM_ENABLE, "WOV_PDM_ENABLE" },
+    { ACP_WOV_PDM_DMA_ENABLE, "WOV_PDM_DMA_ENABLE" },
+    { ACP_WOV_RX_RINGBUFADDR, "WOV_RX_RINGBUFADDR" },
+    { ACP_WOV_RX_RINGBUFSIZE, "WOV_RX_RINGBUFSIZE" },
+    { ACP_WOV_RX_LINEARPOSITIONCNTR_HIGH, "WOV_RX_LINEARPOSITIONCNTR_HIGH" },
+    { ACP_WOV_RX_LINEARPOSITIONCNTR_LOW, "WOV_RX_LINEARPOSITIONCNTR_LOW" },
+    { ACP_WOV_RX_INTR_WATERMARK_SIZE, "WOV_RX_INTR_WATERMARK_SIZE" },
+    { ACP_WOV_PDM_FIFO_FLUSH, "WOV_PDM_FIFO_FLUSH" },
+    { ACP_WOV_PDM_NO_OF_CHANNELS, "WOV_PDM_NO_OF_CHANNELS" },
+    { ACP_WOV_PDM_DECIMATION_FACTOR, "WOV_PDM_DECIMATION_FACTOR" },
+    { ACP_WOV_MISC_CTRL, "WOV_MISC_CTRL" },
+    { ACP_WOV_CLK_CTRL, "WOV_CLK_CTRL" },
+};
+
+static const char* registerName(UInt32 reg)
+{
+    static char scratch[32];
+
+    for (size_t index = 0; index < sizeof(registerNames) / sizeof(registerNames[0]); index++) {
+        if (registerNames[index].reg == reg)
+            return registerNames[index].name;
+    }
+    if (isPTERegister<AMDMicrophoneRenoir>(reg)) {
+        snprintf(scratch, sizeof(scratch), "PTE[%u].%s", (reg - ACP_SCRATCH_REG_0) / 8, reg & 4 ? "high" : "low");
+        return scratch;
+    }
+    snprintf(scratch, sizeof(scratch), "0x%07x", reg);
+    return scratch;
+}
+
+#ifdef __APPLE__
+// The kext stamps events with the TSC, which user space can read too.
+static UInt32 measureCyclesPerMicrosecond()
+{
+    struct timespec start, end;
+    UInt64 startCycles, endCycles, nanoseconds;
+
+    clock_gettime(CLOCK_UPTIME_RAW, &start);
+    startCycles = AMDMicrophoneStats::readCycles();
+    usleep(100000);
+    clock_gettime(CLOCK_UPTIME_RAW, &end);
+    endCycles = AMDMicrophoneStats::readCycles();
+
+    nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+    return (UInt32)((endCycles - startCycles) * 1000 / nanoseconds);
+}
+
+static int dump(const char* path)
+{
+    io_service_t service = IOServiceGetMatchingService(kIOMainPortDefault, IOServiceMatching("AMDMicrophoneDevice"));
+    io_connect_t connect;
+    mach_vm_address_t address = 0;
+    mach_vm_size_t size = 0;
+    AMDMicrophoneTraceHeader header;
+    FILE* file;
+    int result = 1;
+
+    if (!service || IOServiceOpen(service, mach_task_self(), 0, &connect) != KERN_SUCCESS) {
+        fprintf(stderr, "AMDMicrophoneDevice not found\n");
+        return 1;
+    }
+    if (IOConnectMapMemory64(connect, kAMDMicrophoneMemoryTrace, mach_task_self(), &address, &size, kIOMapAnywhere)
+        != KERN_SUCCESS) {
+        fprintf(stderr, "The trace is off; set RegisterTrace to true\n");
+        goto Done;
+    }
+
+    file = fopen(path, "wb");
+    if (file) {
+        result = fwrite((const void*)address, size, 1, file) != 1;
+        header = *(const AMDMicrophoneTraceHeader*)address;
+        header.cyclesPerMicrosecond = measureCyclesPerMicrosecond();
+        if (!result && (fseek(file, 0, SEEK_SET) || fwrite(&header, sizeof(header), 1, file) != 1))
+            result = 1;
+        fclose(file);
+    }
+    IOConnectUnmapMemory64(connect, kAMDMicrophoneMemoryTrace, mach_task_self(), address);
+
+Done:
+    IOServiceClose(connect);
+    IOObjectRelease(service);
+    return result;
+}
+#endif
+
+static AMDMicrophoneTraceBuffer* load(const char* path)
+{
+    AMDMicrophoneTraceBuffer* buffer = (AMDMicrophoneTraceBuffer*)calloc(1, sizeof(AMDMicrophoneTraceBuffer));
+    FILE* file = fopen(path, "rb");
+
+    if (!buffer || !file || fread(buffer, sizeof(*buffer), 1, file) != 1 || buffer->header.magic != TRACE_MAGIC
+        || buffer->header.version != TRACE_VERSION || buffer->header.events != TRACE_EVENTS) {
+        fprintf(stderr, "%s is not a version %u trace\n", path, TRACE_VERSION);
+        free(buffer);
+        buffer = NULL;
+    }
+    if (file)
+        fclose(file);
+
+    return buffer;
+}
+
+static const char* entryName(UInt32 entry)
+{
+    return entry < kTraceEntryCount ? traceEntryNames[entry] : "unknown";
+}
+
+static void show(const AMDMicrophoneTraceEvent* events, UInt64 count)
+{
+    for (UInt64 index = 0; index < count; index++) {
+        const AMDMicrophoneTraceEvent* event = &events[index];
+        UInt64 cycles = event->cycles - events[0].cycles;
+
+        switch (event->type) {
+        case kTraceRead:
+            printf("%14llu %2u  read   %-32s 0x%08x\n", (unsigned long long)cycles, event->thread,
+                registerName(event->reg), event->value);
+            break;
+        case kTraceWrite:
+            printf("%14llu %2u  write  %-32s 0x%08x\n", (unsigned long long)cycles, event->thread,
+                registerName(event->reg), event->value);
+            break;
+        case kTraceEnter:
+            printf("%14llu %2u  enter  %-32s 0x%08x\n", (unsigned long long)cycles, event->thread,
+                entryName(event->reg), event->value);
+            break;
+        case kTraceExit:
+            printf("%14llu %2u  exit   %-32s 0x%08x\n", (unsigned long long)cycles, event->thread,
+                entryName(event->reg), event->value);
+            break;
+        }
+    }
+}
+
+// Runs the register sequence of one entry point. Returns false if the
+// recorded result is not the one the code arrives at. The convert and
+// current frame paths only read the counter while the clock model has not
+// locked, which the recording itself tells.
+static bool replayEntry(
+    ReplayACP& acp, const AMDMicrophoneTraceHeader& header, UInt32 entry, UInt32 argument, UInt32 result,
+    UInt64 accesses
+)
+{
+    AMDMicrophoneDMARun run = { 0, header.pages };
+
+    switch (entry) {
+    case kTraceEntryInterrupt:
+        if (!acp.acknowledgeInterrupt())
+            return result == 0;
+        acp.getRelativeByteCount();
+        return result == 1;
+    case kTraceEntryConvert:
+    case kTraceEntryCurrentFrame:
+        if (accesses)
+            acp.getRelativeByteCount();
+        return true;
+    case kTraceEntryPowerUp:
+        return (UInt32)acp.powerUp(&run, 1) == result;
+    case kTraceEntryPowerDown:
+        return (UInt32)acp.powerDown() == result;
+    case kTraceEntryStartCapture:
+        return (UInt32)acp.startCapture(
+                   header.bufferSize, TRACE_CAPTURE_WATERMARK(argument), TRACE_CAPTURE_CHANNELS(argument)
+               )
+            == result;
+    case kTraceEntryStopCapture:
+        return (UInt32)acp.stopCapture() == result;
+    case kTraceEntryStopListening:
+        acp.getRelativeByteCount();
+        return (UInt32)acp.stopCapture() == result;
+    default:
+        return false;
+    }
+}
+
+// Whether an entry point depends on the configuration registers the shadow
+// holds. Power up and down start from a cleared shadow, as the kext's is
+// cleared by every power cycle and soft reset, and leave it in step with the
+// kext's; capture start and stop only replay after one of them.
+static bool needsShadow(UInt32 entry)
+{
+    return entry == kTraceEntryStartCapture || entry == kTraceEntryStopCapture || entry == kTraceEntryStopListening;
+}
+
+struct EntryTimes {
+    UInt64 calls;
+    UInt64 cycles;
+    UInt64 maxCycles;
+};
+
+// Every entry point is replayed from its enter to its exit marker with the
+// register accesses of its own thread, through the same bus stack as the
+// kext, in the order the entry points started. An entry point cut off by
+// either end of the trace is left out.
+static int check(const AMDMicrophoneTraceHeader& header, const AMDMicrophoneTraceEvent* events, UInt64 count)
+{
+    static ReplayACP acp;
+    AMDMicrophoneTraceEvent* window = (AMDMicrophoneTraceEvent*)calloc(count + 1, sizeof(AMDMicrophoneTraceEvent));
+    EntryTimes times[kTraceEntryCount] = {};
+    UInt64 replayed = 0, diverged = 0, skipped = 0, shortDelays = 0;
+    bool shadowKnown = false;
+
+    if (!window)
+        return 1;
+
+    acp.bus.cyclesPerMicrosecond = header.cyclesPerMicrosecond;
+
+    for (UInt64 index = 0; index < count; index++) {
+        const AMDMicrophoneTraceEvent* enter = &events[index];
+        const AMDMicrophoneTraceEvent* exit = NULL;
+        UInt64 accesses = 0;
+        UInt32 depth = 0;
+
+        if (enter->type != kTraceEnter || enter->reg >= kTraceEntryCount)
+            continue;
+
+        for (UInt64 other = index + 1; other < count && !exit; other++) {
+            const AMDMicrophoneTraceEvent* event = &events[other];
+
+            if (event->thread != enter->thread)
+                continue;
+            if (event->type == kTraceEnter)
+                depth++;
+            else if (event->type == kTraceExit && depth)
+                depth--;
+            else if (event->type == kTraceExit)
+                exit = event;
+            else
+                window[accesses++] = *event;
+        }
+        if (!exit || exit->reg != enter->reg)
+            continue;
+
+        if (needsShadow(enter->reg) && !shadowKnown) {
+            skipped++;
+            continue;
+        }
+
+        if (enter->reg == kTraceEntryPowerUp || enter->reg == kTraceEntryPowerDown)
+            acp.bus.invalidate();
+        acp.bus.load(window, accesses);
+        bool matched = replayEntry(acp, header, enter->reg, enter->value, exit->value, accesses);
+        if (enter->reg == kTraceEntryPowerUp || enter->reg == kTraceEntryPowerDown)
+            shadowKnown = true;
+
+        replayed++;
+        if (!matched || acp.bus.diverged || acp.bus.position != accesses) {
+            printf("%s at event %llu diverges", entryName(enter->reg), (unsigned long long)index);
+            if (acp.bus.diverged || acp.bus.position != accesses)
+                printf(" at its access %llu", (unsigned long long)(acp.bus.diverged ? acp.bus.divergence : acp.bus.position));
+            else
+                printf(" in its result 0x%08x", exit->value);
+            printf("\n");
+            diverged++;
+            // The shadow may now disagree with the kext's.
+            shadowKnown = false;
+        }
+
+        times[enter->reg].calls++;
+        times[enter->reg].cycles += exit->cycles - enter->cycles;
+        if (exit->cycles - enter->cycles > times[enter->reg].maxCycles)
+            times[enter->reg].maxCycles = exit->cycles - enter->cycles;
+    }
+
+    shortDelays = acp.bus.shortDelays;
+    free(window);
+
+    printf("%-14s %8s %12s %12s\n", "entry", "calls", header.cyclesPerMicrosecond ? "mean us" : "mean cycles",
+        header.cyclesPerMicrosecond ? "max us" : "max cycles");
+    for (UInt32 entry = 0; entry < kTraceEntryCount; entry++) {
+        double scale = header.cyclesPerMicrosecond ? 1.0 / header.cyclesPerMicrosecond : 1.0;
+
+        if (!times[entry].calls)
+            continue;
+        printf("%-14s %8llu %12.1f %12.1f\n", traceEntryNames[entry], (unsigned long long)times[entry].calls,
+            times[entry].cycles * scale / times[entry].calls, times[entry].maxCycles * scale);
+    }
+
+    printf("%llu entry points replayed, %llu diverged, %llu skipped while the shadow was unknown\n",
+        (unsigned long long)replayed, (unsigned long long)diverged, (unsigned long long)skipped);
+    if (header.cyclesPerMicrosecond)
+        printf("%llu delays shorter than requested\n", (unsigned long long)shortDelays);
+    else
+        printf("delays not checked; the trace has no TSC rate\n");
+
+    return diverged != 0 || shortDelays != 0;
+}
+
+int main(int argc, char** argv)
+{
+    AMDMicrophoneTraceBuffer* buffer;
+    AMDMicrophoneTraceEvent* events;
+    UInt64 count;
+    int result;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s dump|show|check <trace file>\n", argv[0]);
+        return 2;
+    }
+#ifdef __APPLE__
+    if (!strcmp(argv[1], "dump"))
+        return dump(argv[2]);
+#endif
+
+    buffer = load(argv[2]);
+    events = (AMDMicrophoneTraceEvent*)calloc(TRACE_EVENTS, sizeof(AMDMicrophoneTraceEvent));
+    if (!buffer || !events)
+        return 1;
+
+    count = AMDMicrophoneTrace::copy(buffer, events, TRACE_EVENTS);
+    if (!strcmp(argv[1], "show")) {
+        show(events, count);
+        result = 0;
+    } else if (!strcmp(argv[1], "check"))
+        result = check(buffer->header, events, count);
+    else {
+        fprintf(stderr, "unknown command %s\n", argv[1]);
+        result = 2;
+    }
+
+    free(events);
+    free(buffer);
+    return result;
+}
@@ -0,0 +1,465 @@
+//
+//  AMDMicrophoneSimulate.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+// Drives the kext's ACP register code against AMDMicrophoneModel, so the
+// start and stop paths can be run and timed without a Renoir laptop. The
+// steps issue the same calls as AMDMicrophoneDevice and AMDMicrophoneEngine,
+// through the same shadow bus, and the times are those of the model's clock.
+//
+//   c++ -std=c++17 -O2 -I AMDMicrophone -I Tools Tools/AMDMicrophoneSimulate.cpp -o simulate
+//   ./simulate cycle|maps [-b ring bytes] [-w watermark bytes] [-c 2|4] [-i interrupts] [-l latency us]
+//                         [-n cycles] [-t trace file]
+//   ./simulate latency [-p profile] [-f client frames] [-b ring bytes] [-c 2|4] [-l latency us]
+//
+// cycle powers the model up, then the given number of times starts capture,
+// takes the given number of watermark interrupts, each latency microseconds
+// after it asserts, and stops, as recording does while the ACP stays
+// powered; then it powers down. Every interrupt checks the position counter
+// and the ring contents the model wrote through the PTEs. Each step and each
+// start and stop cycle reports the reads and writes that reached the model
+// and those the shadow answered or dropped. With -t the register
+// traffic is also saved as a register trace, which replay check accepts.
+// Its event times are host time, not model time, so it has no TSC rate.
+// maps runs cycle once for every register map the kext can select, with the
+// model laid out by that map.
+//
+// latency runs each of the engine's latency profiles, or the one given, for
+// LATENCY_SECONDS of capture: the watermark interrupt at the profile's period
+// feeds the engine's clock model, and every client frames a client reads the
+// frames up to the position the engine reports less the input safety offset.
+// The capture-to-client latency of a frame is the time from the model writing
+// it to the read that delivers it. Reads of frames the ring does not yet hold
+// count as errors.
+
+#include "AMDMicrophoneACP.hpp"
+#include "AMDMicrophoneClock.hpp"
+#include "AMDMicrophoneModel.hpp"
+#include "AMDMicrophoneShadow.hpp"
+#include "AMDMicrophoneTrace.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+// Engine defaults, see AMDMicrophoneEngine.hpp.
+#define RING_BYTES      61440
+#define WATERMARK_BYTES 7680
+
+#define CLIENT_FRAMES   512
+#define LATENCY_SECONDS 10
+
+// The engine's latency profiles, see latencyProfiles in AMDMicrophoneEngine.cpp.
+static const struct {
+    const char* name;
+    UInt32 periodFrames;
+} latencyProfiles[] = {
+    { "Default", 960 },
+    { "Low", 256 },
+    { "UltraLow", 128 },
+};
+
+template <typename Map>
+using SimulatedACP = AMDMicrophoneACP<
+    AMDMicrophoneShadow<AMDMicrophoneTraceBus<AMDMicrophoneModel<Map>, Map>, Map>, Map>;
+
+struct Options {
+    UInt32 ringBytes = RING_BYTES;
+    UInt32 watermarkBytes = WATERMARK_BYTES;
+    UInt32 channels = 2;
+    UInt32 interrupts = 50;
+    UInt32 latencyMicroseconds = 20;
+    UInt32 cycles = 1;
+    const char* tracePath = NULL;
+    const char* profile = NULL;
+    UInt32 clientFrames = CLIENT_FRAMES;
+};
+
+// Model time and bus traffic of one step.
+template <typename Map>
+class Step {
+    SimulatedACP<Map>& acp;
+    UInt64 start;
+    AMDMicrophoneMMIOCounts counts;
+
+public:
+    Step(SimulatedACP<Map>& owner)
+        : acp(owner)
+        , start(owner.bus.now)
+        , counts(owner.bus.counts)
+    {
+        owner.lastPollCount = 0;
+    }
+
+    void report(const char* name, IOReturn result)
+    {
+        printf("%-12s %10.1f %6llu %6llu %6llu %6llu %6u  %s\n", name, (acp.bus.now - start) / 1000.0,
+            (unsigned long long)(acp.bus.counts.reads - counts.reads),
+            (unsigned long long)(acp.bus.counts.writes - counts.writes),
+            (unsigned long long)(acp.bus.counts.readsAvoided - counts.readsAvoided),
+            (unsigned long long)(acp.bus.counts.writesAvoided - counts.writesAvoided), acp.lastPollCount,
+            result == kIOReturnSuccess ? "ok" : "failed");
+    }
+};
+
+// Frames the ring holds that do not carry the model's sample values.
+static UInt64 checkRing(const UInt32* ring, const Options& options, UInt64 firstFrame, UInt64 endFrame)
+{
+    UInt32 ringFrames = options.ringBytes / (options.channels * 4);
+    UInt64 errors = 0;
+
+    if (endFrame - firstFrame > ringFrames)
+        firstFrame = endFrame - ringFrames;
+
+    for (UInt64 frame = firstFrame; frame < endFrame; frame++) {
+        const UInt32* samples = &ring[frame % ringFrames * options.channels];
+
+        for (UInt32 channel = 0; channel < options.channels; channel++) {
+            if (samples[channel] != (UInt32)(frame * options.channels + channel)) {
+                errors++;
+                break;
+            }
+        }
+    }
+
+    return errors;
+}
+
+static bool saveTrace(const char* path, const AMDMicrophoneTraceBuffer* buffer)
+{
+    FILE* file = fopen(path, "wb");
+    bool saved;
+
+    if (!file)
+        return false;
+    saved = fwrite(buffer, sizeof(*buffer), 1, file) == 1;
+    return fclose(file) == 0 && saved;
+}
+
+template <typename Map>
+static int cycle(const Options& options)
+{
+    static SimulatedACP<Map> acp;
+    static AMDMicrophoneTraceBuffer traceBuffer;
+    AMDMicrophoneTrace trace;
+    UInt32 pages = (options.ringBytes + ACP_DMA_PAGE_SIZE - 1) / ACP_DMA_PAGE_SIZE;
+    UInt32* ring = (UInt32*)aligned_alloc(ACP_DMA_PAGE_SIZE, pages * ACP_DMA_PAGE_SIZE);
+    UInt64 frameBytes = options.channels * 4;
+    UInt64 lastFrame = 0, counterErrors = 0, ringErrors = 0, handlerNanoseconds = 0;
+    UInt64 lastInterrupt = 0, periodNanoseconds = 0, periods = 0, totalFrames = 0;
+    AMDMicrophoneDMARun run = { (UInt64)(uintptr_t)ring, pages };
+    UInt32 interrupts = 0, cycles = 0;
+    IOReturn ret;
+
+    if (!ring)
+        return 1;
+    memset(ring, 0, pages * ACP_DMA_PAGE_SIZE);
+
+    if (options.tracePath) {
+        trace.attach(&traceBuffer, options.ringBytes, pages);
+        acp.bus.trace = &trace;
+    }
+
+    printf("%s\n%-12s %10s %6s %6s %6s %6s %6s\n%-12s %10s %6s %6s %6s %6s\n", Map::name, "step", "us", "reads",
+        "writes", "reads", "writes", "polls", "", "", "", "", "saved", "saved");
+
+    {
+        Step<Map> power(acp);
+        AMDMicrophoneTraceScope scope(trace, kTraceEntryPowerUp, pages);
+        ret = acp.powerUp(&run, 1);
+        scope.result = ret;
+        power.report("power up", ret);
+        if (ret != kIOReturnSuccess)
+            goto Done;
+    }
+
+    while (cycles < options.cycles) {
+        Step<Map> capture(acp);
+        UInt32 cycleInterrupts = 0;
+        char name[24];
+
+        lastFrame = 0;
+        {
+            Step<Map> start(acp);
+            AMDMicrophoneTraceScope scope(
+                trace, kTraceEntryStartCapture, TRACE_CAPTURE_ARGUMENT(options.watermarkBytes, options.channels)
+            );
+            ret = acp.startCapture(options.ringBytes, options.watermarkBytes, options.channels);
+            scope.result = ret;
+            start.report("start", ret);
+            if (ret != kIOReturnSuccess)
+                goto Done;
+        }
+
+        while (cycleInterrupts < options.interrupts) {
+            UInt64 due = acp.bus.nextInterrupt();
+            UInt64 entered, byteCount, frame;
+
+            if (!due && !acp.bus.isInterruptAsserted())
+                break;
+            acp.bus.advance(due + options.latencyMicroseconds * 1000ULL);
+            if (!acp.bus.isInterruptAsserted())
+                continue;
+
+            entered = acp.bus.now;
+            {
+                AMDMicrophoneTraceScope scope(trace, kTraceEntryInterrupt);
+                if (!acp.acknowledgeInterrupt())
+                    continue;
+                scope.result = 1;
+                byteCount = acp.getRelativeByteCount();
+            }
+            handlerNanoseconds += acp.bus.now - entered;
+
+            if (cycleInterrupts) {
+                periodNanoseconds += entered - lastInterrupt;
+                periods++;
+            }
+            lastInterrupt = entered;
+            interrupts++;
+            cycleInterrupts++;
+
+            frame = byteCount / frameBytes;
+            if (byteCount % frameBytes || frame < lastFrame)
+                counterErrors++;
+            else {
+                ringErrors += checkRing(ring, options, lastFrame, frame);
+                lastFrame = frame;
+            }
+        }
+
+        {
+            Step<Map> stop(acp);
+            AMDMicrophoneTraceScope scope(trace, kTraceEntryStopCapture);
+            ret = acp.stopCapture();
+            scope.result = ret;
+            stop.report("stop", ret);
+            if (ret != kIOReturnSuccess)
+                goto Done;
+        }
+
+        cycles++;
+        snprintf(name, sizeof(name), "cycle %u", cycles);
+        capture.report(name, ret);
+        totalFrames += lastFrame;
+    }
+
+    {
+        Step<Map> down(acp);
+        AMDMicrophoneTraceScope scope(trace, kTraceEntryPowerDown);
+        ret = acp.powerDown();
+        scope.result = ret;
+        down.report("power down", ret);
+    }
+
+Done:
+    printf("\n%u interrupts", interrupts);
+    if (periods)
+        printf(", period %.1f us", periodNanoseconds / 1000.0 / periods);
+    if (interrupts)
+        printf(", handler %.1f us", handlerNanoseconds / 1000.0 / interrupts);
+    printf("\n%llu frames, %llu counter errors, %llu ring errors, %llu DMA faults, %llu accesses while off\n",
+        (unsigned long long)totalFrames, (unsigned long long)counterErrors, (unsigned long long)ringErrors,
+        (unsigned long long)acp.bus.dmaFaults, (unsigned long long)acp.bus.offAccesses);
+
+    if (options.tracePath && !saveTrace(options.tracePath, &traceBuffer)) {
+        fprintf(stderr, "cannot write %s\n", options.tracePath);
+        ret = kIOReturnError;
+    }
+
+    free(ring);
+    return ret != kIOReturnSuccess || interrupts != options.interrupts * options.cycles || counterErrors || ringErrors
+        || acp.bus.dmaFaults || acp.bus.offAccesses;
+}
+
+// Capture with one latency profile; the input safety offset is two periods,
+// as AMDMicrophoneEngine::updateBufferGeometry() sets it.
+template <typename Map>
+static bool measureLatency(SimulatedACP<Map>& acp, const UInt32* ring, const Options& options, const char* name,
+    UInt32 periodFrames)
+{
+    UInt64 frameBytes = options.channels * 4;
+    UInt64 offsetFrames = 2 * periodFrames;
+    UInt64 clientNanoseconds = options.clientFrames * 1000000000ULL / MODEL_SAMPLE_RATE;
+    UInt64 start, nextRead, due, interruptAt = 0, position, endFrame, readFrame = 0, frames = 0, reads = 0, fallbacks = 0, errors = 0;
+    UInt64 latency, latencySum = 0, latencyMin = ~0ULL, latencyMax = 0;
+    UInt32 interrupts = 0;
+    AMDMicrophoneClock clock;
+    IOReturn ret;
+
+    clock.configure(1000000000, MODEL_SAMPLE_RATE, periodFrames);
+    ret = acp.startCapture(options.ringBytes, periodFrames * frameBytes, options.channels);
+    if (ret != kIOReturnSuccess) {
+        printf("%-10s start failed\n", name);
+        return false;
+    }
+
+    start = acp.bus.now;
+    nextRead = start + clientNanoseconds;
+    while (acp.bus.now - start < LATENCY_SECONDS * 1000000000ULL) {
+        if (!interruptAt && (due = acp.bus.nextInterrupt()))
+            interruptAt = acp.bus.now + due + options.latencyMicroseconds * 1000ULL;
+
+        if (interruptAt && interruptAt < nextRead) {
+            UInt64 entered, byteCount;
+
+            acp.bus.advance(interruptAt - acp.bus.now);
+            interruptAt = 0;
+            entered = acp.bus.now;
+            if (!acp.bus.isInterruptAsserted() || !acp.acknowledgeInterrupt())
+                continue;
+            byteCount = acp.getRelativeByteCount();
+            clock.update(entered + (acp.bus.now - entered) / 2, byteCount / frameBytes);
+            interrupts++;
+            continue;
+        }
+
+        acp.bus.advance(nextRead - acp.bus.now);
+        nextRead += clientNanoseconds;
+        if (!clock.predict(acp.bus.now, &position)) {
+            position = acp.getRelativeByteCount() / frameBytes;
+            fallbacks++;
+        }
+        if (position < offsetFrames || position - offsetFrames <= readFrame)
+            continue;
+
+        endFrame = position - offsetFrames;
+        errors += checkRing(ring, options, readFrame, endFrame);
+        for (; readFrame < endFrame; readFrame++) {
+            UInt64 written = acp.bus.frameTime(readFrame);
+
+            latency = acp.bus.now > written ? acp.bus.now - written : 0;
+            latencySum += latency;
+            latencyMin = latency < latencyMin ? latency : latencyMin;
+            latencyMax = latency > latencyMax ? latency : latencyMax;
+            frames++;
+        }
+        reads++;
+    }
+
+    ret = acp.stopCapture();
+    printf("%-10s %6u %7.1f %7.1f %10u %7llu %9llu %7.2f %7.2f %7.2f %7llu\n", name, periodFrames,
+        periodFrames * 1000.0 / MODEL_SAMPLE_RATE, offsetFrames * 1000.0 / MODEL_SAMPLE_RATE, interrupts,
+        (unsigned long long)reads, (unsigned long long)fallbacks, frames ? latencyMin / 1e6 : 0.0,
+        frames ? latencySum / 1e6 / frames : 0.0, latencyMax / 1e6, (unsigned long long)errors);
+
+    return ret == kIOReturnSuccess && frames && !errors;
+}
+
+template <typename Map>
+static int latency(const Options& options)
+{
+    static SimulatedACP<Map> acp;
+    UInt32 pages = (options.ringBytes + ACP_DMA_PAGE_SIZE - 1) / ACP_DMA_PAGE_SIZE;
+    UInt32* ring;
+    AMDMicrophoneDMARun run;
+    bool passed = true, matched = !options.profile;
+    IOReturn ret;
+
+    for (const auto& profile : latencyProfiles)
+        matched = matched || !strcasecmp(options.profile, profile.name);
+    if (!matched) {
+        fprintf(stderr, "unknown profile %s\n", options.profile);
+        return 2;
+    }
+
+    ring = (UInt32*)aligned_alloc(ACP_DMA_PAGE_SIZE, pages * ACP_DMA_PAGE_SIZE);
+    run = { (UInt64)(uintptr_t)ring, pages };
+    if (!ring)
+        return 1;
+    memset(ring, 0, pages * ACP_DMA_PAGE_SIZE);
+
+    ret = acp.powerUp(&run, 1);
+    if (ret != kIOReturnSuccess) {
+        fprintf(stderr, "power up failed\n");
+        goto Done;
+    }
+
+    printf("%s, %u client frames, interrupt latency %u us\n%-10s %6s %7s %7s %10s %7s %9s %7s %7s %7s %7s\n",
+        Map::name, options.clientFrames, options.latencyMicroseconds, "profile", "period", "ms", "offset",
+        "interrupts", "reads", "fallbacks", "min", "mean", "max", "errors");
+    for (const auto& profile : latencyProfiles) {
+        if (!options.profile || !strcasecmp(options.profile, profile.name))
+            passed = measureLatency(acp, ring, options, profile.name, profile.periodFrames) && passed;
+    }
+
+    ret = acp.powerDown();
+
+Done:
+    free(ring);
+    return ret != kIOReturnSuccess || !passed;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    int option;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s cycle|maps|latency [options]\n", argv[0]);
+        return 2;
+    }
+
+    optind = 2;
+    while ((option = getopt(argc, argv, "b:w:c:i:l:n:t:p:f:")) != -1) {
+        switch (option) {
+        case 'b':
+            options.ringBytes = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            options.watermarkBytes = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            options.channels = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            options.interrupts = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            options.latencyMicroseconds = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            options.cycles = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            options.tracePath = optarg;
+            break;
+        case 'p':
+            options.profile = optarg;
+            break;
+        case 'f':
+            options.clientFrames = (UInt32)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            return 2;
+        }
+    }
+
+    if ((options.channels != 2 && options.channels != 4) || !options.watermarkBytes || !options.clientFrames
+        || options.ringBytes % (options.channels * 4) || options.ringBytes > ACP_PTE_WINDOW / 8 * ACP_DMA_PAGE_SIZE) {
+        fprintf(stderr, "invalid ring geometry\n");
+        return 2;
+    }
+
+    if (!strcmp(argv[1], "cycle"))
+        return cycle<AMDMicrophoneRenoir>(options);
+    if (!strcmp(argv[1], "maps")) {
+        // replay reads traces with the Renoir map, so only that run is traced.
+        Options untraced = options;
+        int failed = cycle<AMDMicrophoneRenoir>(options);
+
+        untraced.tracePath = NULL;
+        printf("\n");
+        return cycle<AMDMicrophoneYellowCarp>(untraced) || failed;
+    }
+    if (!strcmp(argv[1], "latency"))
+        return latency<AMDMicrophoneRenoir>(options);
+
+    fprintf(stderr, "unknown command %s\n", argv[1]);
+    return 2;
+}
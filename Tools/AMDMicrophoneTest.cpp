@@ -0,0 +1,835 @@
+//
+//  AMDMicrophoneTest.cpp
+//  AMDMicrophone
+//
+//  Created by Huy Duong on 17/10/2026.
+//
+
+// Host checks of kext code that has no hardware dependency. Each command
+// prints what it compared and exits non-zero on a failure.
+//
+//   c++ -std=c++17 -O2 -msse2 -pthread -I AMDMicrophone Tools/AMDMicrophoneTest.cpp -o test
+//   ./test fixed
+//   ./test tap [-r readers] [-f frames]
+//   ./test clock [-j jitter us] [-d drift ppm] [-p period frames] [-s seconds]
+//   ./test input file.wav
+//
+// fixed runs the fixed-point pipeline of AMDMicrophoneDSP and a plain
+// per-sample reference of the same Q31 arithmetic over synthetic inputs,
+// for 2 and 4 capture channels, every client format, several parameter
+// sets and convert calls of uneven sizes, and requires the outputs to match
+// bit for bit. The volume is held constant, since a volume ramp depends on
+// the block split by design.
+//
+// tap runs AMDMicrophoneTap with several reader threads that read at
+// uneven sizes and speeds, and a producer driven by a 50 us timer signal
+// that interrupts them at random points, so reads race with writes even on
+// one CPU and the slow readers are overrun. Every sample carries its frame number and every chunk a host
+// time derived from its first frame, so a reader can check that whatever it
+// got is what was written at that position, that its lost count and
+// position agree, and that getTime() gives the right time. Before that it
+// feeds the tap convert calls over a small client ring the way the engine
+// does, with repeated, overlapping, skipping and wrapping ranges, and checks
+// that each ring frame reaches the tap once and that skips are flagged.
+//
+// clock feeds AMDMicrophoneClock the (host time, counter) pairs the
+// interrupt handler would take from a simulated DMA whose rate is off by
+// the given drift, with interrupts that arrive late by up to the given
+// jitter and now and then by several periods. It reports, once the loop
+// has locked, the error of the wrap timestamps the engine passes to
+// takeTimeStamp(), the same error for stamping each wrap with the time of
+// the interrupt that saw it, and the error of predict() at random times.
+// The counter truncates to whole frames, so the mean error carries half a
+// frame, about 10 us, whenever the interrupts are not exactly on time.
+// Without options it runs a matrix of jitter, drift and period size and
+// fails if any wrap timestamp is off by more than CLOCK_TEST_LIMIT_US or the
+// loop relocks.
+//
+// input writes the stereo capture that Tools/Golden/check.sh runs through
+// process: GOLDEN_FRAMES of 48 kHz 32-bit PCM in five equal parts, digital
+// silence, quiet noise, a tone over rumble, a tone driven into the clamp
+// and a gated burst. The committed input.wav is the reference; this only
+// documents and regenerates it.
+
+#include "AMDMicrophoneClock.hpp"
+#include "AMDMicrophoneDSP.hpp"
+#include "AMDMicrophoneTap.hpp"
+
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_FRAMES 96000
+
+#define GOLDEN_FRAMES   7200
+#define GOLDEN_CHANNELS 2
+
+// Tap frames are numbered modulo 2^24, which a float holds exactly.
+#define TAP_TEST_READERS     4
+#define TAP_TEST_MAX_READERS 64
+#define TAP_TEST_FRAMES      (16ULL << 20)
+#define TAP_TEST_MODULO      (1U << 24)
+#define TAP_TEST_TICKS       1000
+#define TAP_TEST_CALL_FRAMES 4096
+#define TAP_TEST_INTERVAL    50
+#define TAP_TEST_DAWDLE      2000
+#define TAP_TEST_RING_FRAMES 2048
+
+// Engine defaults, see AMDMicrophoneEngine.hpp: a 7680-frame ring and
+// 960-frame periods. The counter read takes about 1 us, and one interrupt in
+// CLOCK_TEST_SPIKE_ODDS arrives up to CLOCK_TEST_SPIKE_PERIODS late.
+#define CLOCK_TEST_RING_FRAMES   7680
+#define CLOCK_TEST_PERIOD_FRAMES 960
+#define CLOCK_TEST_SECONDS       600
+#define CLOCK_TEST_READ_NS       1000
+#define CLOCK_TEST_SPIKE_ODDS    200
+#define CLOCK_TEST_SPIKE_PERIODS 3
+#define CLOCK_TEST_LOCK_SECONDS  10
+#define CLOCK_TEST_LIMIT_US      25.0
+
+// Per-sample model of the fixed-point chain: mono mix, volume, high-pass,
+// expander, software gain and startup fade, written from the definitions
+// rather than from the vector kernels.
+class ReferenceFixed {
+    SInt64 coefficients[HIGHPASS_SECTIONS][5];
+    SInt64 history[HIGHPASS_SECTIONS][4] = {};
+    bool highpass;
+    SInt32 volume;
+    SInt32 threshold, floor, attack, release;
+    SInt64 slope;
+    SInt64 envelope = 0;
+    SInt64 gain;
+    SInt32 mantissa;
+    UInt32 shift = 0;
+    UInt32 fadeFrame = 0, fadeFrames, fadeStep;
+
+    static SInt64 saturate(SInt64 value)
+    {
+        return value > FIXED_Q31_MAX ? FIXED_Q31_MAX : value < FIXED_Q31_MIN ? FIXED_Q31_MIN : value;
+    }
+
+    // Q31 times Q15, dropping bit 0 of the sample first.
+    static SInt64 scale(SInt64 sample, SInt64 q15) { return ((sample >> 1) * q15) >> 14; }
+
+public:
+    explicit ReferenceFixed(const AMDMicrophoneDSPParameters& parameters)
+    {
+        float softwareGain = parameters.softwareGain;
+
+        highpass = true;
+        for (UInt32 index = 0; index < HIGHPASS_SECTIONS; index++) {
+            double designed[5];
+
+            highpass = highpass
+                && AMDMicrophoneHighpass::design(SAMPLE_RATE, parameters.highpassCutoff * 1000.0f, index, designed);
+            for (UInt32 tap = 0; tap < 5; tap++)
+                coefficients[index][tap] = (SInt64)(SInt32)(designed[tap] * (1 << FIXED_FILTER_BITS));
+        }
+
+        volume = fixedQ15(parameters.volumeGain);
+        threshold = fixedQ31(parameters.expanderThreshold);
+        floor = fixedQ31(parameters.expanderFloor);
+        slope = (SInt64)((1.0 - parameters.expanderFloor) / parameters.expanderThreshold * (1 << FIXED_SLOPE_BITS));
+        attack = fixedQ31(parameters.expanderAttack);
+        release = fixedQ31(parameters.expanderRelease);
+        gain = floor;
+
+        while (softwareGain > 1.0f) {
+            softwareGain *= 0.5f;
+            shift++;
+        }
+        mantissa = fixedQ15(softwareGain);
+
+        fadeFrames = (UInt32)(parameters.startupFade * SAMPLE_RATE);
+        fadeStep = fadeFrames ? ((UInt32)FIXED_Q15_ONE << FIXED_RAMP_BITS) / fadeFrames : 0;
+    }
+
+    SInt32 next(const SInt32* frame, UInt32 channels)
+    {
+        UInt32 bits = channels == 4 ? 2 : 1;
+        SInt64 sample = 0, level, target;
+
+        for (UInt32 channel = 0; channel < channels; channel++)
+            sample += frame[channel] >> bits;
+        sample = scale(sample, volume);
+
+        for (UInt32 index = 0; highpass && index < HIGHPASS_SECTIONS; index++) {
+            SInt64* state = history[index];
+            SInt64* c = coefficients[index];
+            SInt64 y = saturate((c[0] * sample + c[1] * state[0] + c[2] * state[1] - c[3] * state[2]
+                                    - c[4] * state[3] + (1LL << (FIXED_FILTER_BITS - 1)))
+                >> FIXED_FILTER_BITS);
+
+            state[1] = state[0];
+            state[0] = sample;
+            state[3] = state[2];
+            state[2] = y;
+            sample = y;
+        }
+
+        level = sample < 0 ? -sample : sample;
+        if (level > FIXED_Q31_MAX)
+            level = FIXED_Q31_MAX;
+        envelope = (envelope * fixedQ31(0.990) + level * fixedQ31(0.010)) >> 31;
+        target = envelope >= threshold ? FIXED_Q31_MAX : saturate(floor + ((envelope * slope) >> FIXED_SLOPE_BITS));
+        gain += ((target - gain) * (target > gain ? attack : release)) >> 31;
+        sample = (sample * gain) >> 31;
+
+        sample = saturate(scale(sample, mantissa) * ((SInt64)1 << shift));
+
+        if (fadeFrame < fadeFrames) {
+            sample = scale(sample, ((SInt64)fadeFrame * fadeStep) >> FIXED_RAMP_BITS);
+            fadeFrame++;
+        }
+
+        return (SInt32)sample;
+    }
+};
+
+static void fillSignal(SInt32* ring, UInt32 frames, UInt32 channels)
+{
+    UInt32 state = 1;
+
+    for (UInt32 frame = 0; frame < frames; frame++) {
+        // A second each of quiet noise, a full-scale tone with
+        // pinned extremes, and a gated burst.
+        UInt32 second = frame / SAMPLE_RATE % 3;
+
+        for (UInt32 channel = 0; channel < channels; channel++) {
+            SInt32* sample = &ring[frame * channels + channel];
+
+            state = state * 1664525 + 1013904223;
+            if (second == 0)
+                *sample = (SInt32)state >> 10;
+            else if (second == 1) {
+                double tone = sin(2.0 * M_PI * 997.0 * frame / SAMPLE_RATE);
+
+                *sample = tone > 0.99 ? FIXED_Q31_MAX : tone < -0.99 ? FIXED_Q31_MIN : (SInt32)(tone * 2147483647.0);
+            } else
+                *sample = frame / 480 % 2 ? (SInt32)state : 0;
+        }
+    }
+}
+
+template <typename Sample>
+static Sample referenceSample(SInt32 sample);
+
+template <>
+float referenceSample(SInt32 sample)
+{
+    return (float)sample / 2147483648.0f;
+}
+
+template <>
+SInt16 referenceSample(SInt32 sample)
+{
+    return (SInt16)(sample >> 16);
+}
+
+template <typename Sample>
+static bool checkFixed(const SInt32* ring, UInt32 captureChannels, UInt32 outputChannels,
+    const AMDMicrophoneDSPParameters& parameters, const char* name)
+{
+    static const UInt32 chunks[] = { 512, 1, 7, 64, 61, 1024, 3, 960 };
+    static AMDMicrophoneDSP dsp;
+    static Sample output[TEST_FRAMES * 2], expected[TEST_FRAMES * 2];
+    ReferenceFixed reference(parameters);
+    float delays[RESAMPLER_MAX_CHANNELS] = {};
+    UInt32 calls = 0;
+
+    dsp.resampler.setChannels(captureChannels, delays);
+    dsp.resampler.configure(SAMPLE_RATE);
+    dsp.fixedPoint = true;
+    dsp.setParameters(parameters);
+    dsp.reset();
+
+    for (UInt32 done = 0; done < TEST_FRAMES; calls++) {
+        UInt32 count = chunks[calls % (sizeof(chunks) / sizeof(chunks[0]))];
+
+        if (count > TEST_FRAMES - done)
+            count = TEST_FRAMES - done;
+        dsp.process(ring, TEST_FRAMES, done, &output[done * outputChannels], count, outputChannels,
+            sizeof(Sample) * 8);
+        done += count;
+    }
+
+    for (UInt32 frame = 0; frame < TEST_FRAMES; frame++) {
+        Sample sample = referenceSample<Sample>(reference.next(&ring[frame * captureChannels], captureChannels));
+
+        for (UInt32 channel = 0; channel < outputChannels; channel++)
+            expected[frame * outputChannels + channel] = sample;
+    }
+
+    printf("%-22s %u ch to %-6s %-6s ", name, captureChannels, outputChannels == 1 ? "mono" : "stereo",
+        sizeof(Sample) == 2 ? "16-bit" : "float");
+    if (!dsp.fixedActive) {
+        printf("fixed-point pipeline not selected\n");
+        return false;
+    }
+    for (UInt32 index = 0; index < TEST_FRAMES * outputChannels; index++) {
+        if (memcmp(&output[index], &expected[index], sizeof(Sample))) {
+            printf("differs at frame %u\n", index / outputChannels);
+            return false;
+        }
+    }
+    printf("matches\n");
+    return true;
+}
+
+static int testFixed()
+{
+    static SInt32 ring[TEST_FRAMES * 4];
+    AMDMicrophoneDSPParameters defaults, loud, plain;
+    const struct {
+        const AMDMicrophoneDSPParameters* parameters;
+        const char* name;
+    } sets[] = {
+        { &defaults, "defaults" },
+        { &loud, "gain 16, volume 0.5" },
+        { &plain, "no high-pass or fade" },
+    };
+    bool passed = true;
+
+    loud.softwareGain = 16.0f;
+    loud.volumeGain = 0.5f;
+    plain.highpassCutoff = 0.0f;
+    plain.startupFade = 0.0f;
+
+    for (UInt32 captureChannels = 2; captureChannels <= 4; captureChannels += 2) {
+        fillSignal(ring, TEST_FRAMES, captureChannels);
+        for (const auto& set : sets) {
+            for (UInt32 outputChannels = 1; outputChannels <= 2; outputChannels++) {
+                passed &= checkFixed<float>(ring, captureChannels, outputChannels, *set.parameters, set.name);
+                passed &= checkFixed<SInt16>(ring, captureChannels, outputChannels, *set.parameters, set.name);
+            }
+        }
+    }
+
+    return !passed;
+}
+
+static struct {
+    AMDMicrophoneTapBuffer buffer;
+    AMDMicrophoneTap tap;
+    UInt64 frames;
+    UInt64 written;
+    UInt32 state;
+    bool busy;
+    bool done;
+} tapTest;
+
+struct TapReaderResult {
+    UInt32 seed;
+    UInt64 read;
+    UInt64 lost;
+    UInt64 errors;
+    UInt64 times;
+    UInt64 timeErrors;
+};
+
+static UInt32 nextRandom(UInt32* state)
+{
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+// Producer, run from a timer signal in whichever reader thread it lands on,
+// so a reader can be interrupted anywhere, also in the middle of a copy.
+// Writes one convert call as the engine does: a chunk, then the samples in
+// DSP-sized blocks. A tick that arrives while another thread is producing
+// is dropped, which keeps the producer single.
+static void tapTick(int)
+{
+    float samples[CONVERT_BLOCK_FRAMES];
+    UInt32 count;
+
+    if (__atomic_exchange_n(&tapTest.busy, true, __ATOMIC_ACQUIRE))
+        return;
+
+    count = 1 + nextRandom(&tapTest.state) % TAP_TEST_CALL_FRAMES;
+    if (!tapTest.done) {
+        tapTest.tap.mark(tapTest.written * TAP_TEST_TICKS, SAMPLE_RATE);
+        while (count) {
+            UInt32 block = count < CONVERT_BLOCK_FRAMES ? count : CONVERT_BLOCK_FRAMES;
+
+            for (UInt32 index = 0; index < block; index++)
+                samples[index] = (float)((tapTest.written + index) % TAP_TEST_MODULO);
+            tapTest.tap.write(samples, block);
+            tapTest.written += block;
+            count -= block;
+        }
+        if (tapTest.written >= tapTest.frames)
+            __atomic_store_n(&tapTest.done, true, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&tapTest.busy, false, __ATOMIC_RELEASE);
+}
+
+// Sleeps the whole time. The producer's ticks cut usleep() short, and a
+// relative sleep restarted after each of them may never finish.
+static void sleepThrough(UInt32 microseconds)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += (long)microseconds * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL))
+        ;
+}
+
+static void* tapReader(void* argument)
+{
+    TapReaderResult* result = (TapReaderResult*)argument;
+    AMDMicrophoneTapReader reader;
+    float samples[TAP_FRAMES];
+    UInt32 state = result->seed;
+    UInt64 start;
+
+    if (!reader.attach(&tapTest.buffer)) {
+        result->errors++;
+        return NULL;
+    }
+    start = reader.position;
+
+    for (;;) {
+        bool finished = __atomic_load_n(&tapTest.done, __ATOMIC_ACQUIRE);
+        UInt64 lost = reader.lost;
+        UInt32 count = reader.read(samples, 1 + nextRandom(&state) % TAP_FRAMES);
+        UInt64 first = reader.position - count, hostTime;
+
+        result->read += count;
+        for (UInt32 index = 0; index < count; index++) {
+            if (samples[index] != (float)((first + index) % TAP_TEST_MODULO))
+                result->errors++;
+        }
+        if (reader.position - start != result->read + reader.lost || reader.lost < lost)
+            result->errors++;
+
+        if (count && reader.getTime(first, &hostTime)) {
+            result->times++;
+            if (hostTime != first * TAP_TEST_TICKS)
+                result->timeErrors++;
+        }
+
+        if (finished && !count)
+            break;
+        // Readers with odd seeds dawdle past a full ring, so they are
+        // overrun and then copy the slots the producer overwrites next.
+        if (result->seed & 1)
+            sleepThrough(nextRandom(&state) % TAP_TEST_DAWDLE);
+    }
+
+    result->lost = reader.lost;
+    return NULL;
+}
+
+// One convert call over client ring frames, as the engine makes it: feed()
+// and then the samples, each carrying its ring frame, in DSP-sized blocks.
+static void feedTap(AMDMicrophoneTap& tap, UInt32 firstFrame, UInt32 numFrames)
+{
+    float samples[CONVERT_BLOCK_FRAMES];
+
+    tap.feed(firstFrame, numFrames, (UInt64)firstFrame * TAP_TEST_TICKS, SAMPLE_RATE);
+    while (numFrames) {
+        UInt32 block = numFrames < CONVERT_BLOCK_FRAMES ? numFrames : CONVERT_BLOCK_FRAMES;
+
+        for (UInt32 index = 0; index < block; index++)
+            samples[index] = (float)((firstFrame + index) % TAP_TEST_RING_FRAMES);
+        tap.write(samples, block);
+        firstFrame += block;
+        numFrames -= block;
+    }
+}
+
+static bool checkTapFeed()
+{
+    static AMDMicrophoneTapBuffer buffer;
+    static const struct {
+        const char* name;
+        UInt32 firstFrame;
+        UInt32 numFrames;
+        UInt32 newFrames;
+        bool discontinuity;
+    } calls[] = {
+        { "first", 0, 480, 480, false },
+        { "same range", 0, 480, 0, false },
+        { "inside", 100, 200, 0, false },
+        { "overlap", 240, 480, 240, false },
+        { "next", 720, 300, 300, false },
+        { "skip", 1100, 400, 400, true },
+        { "wrap", 1500, 1000, 1000, false },
+        { "wrap again", 2000, 400, 0, false },
+    };
+    AMDMicrophoneTap tap;
+    UInt64 expected = 0;
+    bool passed = true;
+
+    tap.attach(&buffer, (UInt64)SAMPLE_RATE * TAP_TEST_TICKS);
+    tap.restart(TAP_TEST_RING_FRAMES);
+
+    for (const auto& call : calls) {
+        UInt64 frames = buffer.header.writtenFrames, chunks = buffer.header.writtenChunks;
+        UInt32 firstFrame = (call.firstFrame + call.numFrames - call.newFrames) % TAP_TEST_RING_FRAMES;
+        const AMDMicrophoneTapChunk* chunk = &buffer.chunks[chunks & (TAP_CHUNKS - 1)];
+        UInt64 errors = 0;
+
+        feedTap(tap, call.firstFrame, call.numFrames);
+        if (call.newFrames) {
+            if (buffer.header.writtenChunks != chunks + 1 || chunk->firstFrame != frames
+                || chunk->hostTime != (UInt64)(call.firstFrame + call.numFrames - call.newFrames) * TAP_TEST_TICKS
+                || !!(chunk->flags & TAP_CHUNK_DISCONTINUITY) != call.discontinuity)
+                errors++;
+        } else if (buffer.header.writtenChunks != chunks)
+            errors++;
+
+        if (buffer.header.writtenFrames != frames + call.newFrames)
+            errors++;
+        for (UInt32 index = 0; index < call.newFrames && frames + index < buffer.header.writtenFrames; index++) {
+            if (buffer.samples[(frames + index) & (TAP_FRAMES - 1)]
+                != (float)((firstFrame + index) % TAP_TEST_RING_FRAMES))
+                errors++;
+        }
+        expected += call.newFrames;
+
+        printf("feed %-10s %4u+%-4u %4llu new frames, %llu bad\n", call.name, call.firstFrame, call.numFrames,
+            (unsigned long long)(buffer.header.writtenFrames - frames), (unsigned long long)errors);
+        passed &= !errors;
+    }
+
+    return passed && buffer.header.writtenFrames == expected;
+}
+
+static int testTap(UInt32 readers, UInt64 frames)
+{
+    struct itimerval timer = { { 0, TAP_TEST_INTERVAL }, { 0, TAP_TEST_INTERVAL } };
+    struct itimerval stopped = {};
+    struct sigaction action = {};
+    sigset_t alarm;
+    pthread_t threads[TAP_TEST_MAX_READERS];
+    TapReaderResult results[TAP_TEST_MAX_READERS] = {};
+    bool passed = true;
+
+    if (!readers || readers > TAP_TEST_MAX_READERS || !frames)
+        return 2;
+
+    passed = checkTapFeed();
+
+    tapTest.frames = frames;
+    tapTest.state = 7;
+    tapTest.tap.attach(&tapTest.buffer, (UInt64)SAMPLE_RATE * TAP_TEST_TICKS);
+
+    action.sa_handler = tapTick;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &action, NULL);
+
+    for (UInt32 index = 0; index < readers; index++) {
+        results[index].seed = index + 1;
+        pthread_create(&threads[index], NULL, tapReader, &results[index]);
+    }
+
+    // The ticks have to land in the readers, not in this waiting thread.
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, NULL);
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    for (UInt32 index = 0; index < readers; index++)
+        pthread_join(threads[index], NULL);
+    setitimer(ITIMER_REAL, &stopped, NULL);
+
+    printf("%llu frames written in %llu chunks\n", (unsigned long long)tapTest.buffer.header.writtenFrames,
+        (unsigned long long)tapTest.buffer.header.writtenChunks);
+    for (UInt32 index = 0; index < readers; index++) {
+        TapReaderResult* result = &results[index];
+
+        printf("reader %u: %llu read, %llu lost, %llu bad, %llu times checked, %llu wrong\n", index,
+            (unsigned long long)result->read, (unsigned long long)result->lost, (unsigned long long)result->errors,
+            (unsigned long long)result->times, (unsigned long long)result->timeErrors);
+        passed &= !result->errors && !result->timeErrors && result->read;
+    }
+
+    return !passed;
+}
+
+struct ClockScenario {
+    double jitterMicroseconds;
+    double driftPPM;
+    UInt32 periodFrames;
+    UInt32 seconds;
+};
+
+// Error statistics in microseconds, or frames for the position.
+struct ClockError {
+    double sum = 0.0;
+    double squares = 0.0;
+    double worst = 0.0;
+    UInt64 count = 0;
+
+    void add(double error)
+    {
+        sum += error;
+        squares += error * error;
+        if (fabs(error) > worst)
+            worst = fabs(error);
+        count++;
+    }
+
+    double mean() const { return count ? sum / count : 0.0; }
+    double rms() const { return count ? sqrt(squares / count) : 0.0; }
+};
+
+static double uniformRandom(UInt32* state)
+{
+    return nextRandom(state) / 16777216.0;
+}
+
+static bool testClock(const ClockScenario& scenario)
+{
+    const double nanosecondsPerFrame = 1e9 / (SAMPLE_RATE * (1.0 + scenario.driftPPM * 1e-6));
+    const UInt64 start = 1000000000ULL;
+    const UInt64 lockTime = start + CLOCK_TEST_LOCK_SECONDS * 1000000000ULL;
+    AMDMicrophoneClock clock;
+    ClockError model, interrupt, position;
+    UInt64 nextWrapFrame = CLOCK_TEST_RING_FRAMES, lastWrapTime = start, fallbacks = 0, queries = 0;
+    UInt64 periods = (UInt64)scenario.seconds * SAMPLE_RATE / scenario.periodFrames;
+    UInt32 state = 11;
+    bool passed;
+
+    clock.configure(1000000000ULL, SAMPLE_RATE, scenario.periodFrames);
+
+    for (UInt64 period = 1; period <= periods; period++) {
+        // The watermark fires when the DMA passes the period boundary; the
+        // handler runs late and reads the counter between two host times.
+        double due = start + period * scenario.periodFrames * nanosecondsPerFrame;
+        double late = uniformRandom(&state) * scenario.jitterMicroseconds * 1000.0;
+        double read, before, after;
+        UInt64 time, frame;
+
+        if (nextRandom(&state) % CLOCK_TEST_SPIKE_ODDS == 0)
+            late += uniformRandom(&state) * CLOCK_TEST_SPIKE_PERIODS * scenario.periodFrames * nanosecondsPerFrame;
+        before = due + late;
+        after = before + CLOCK_TEST_READ_NS * (0.5 + uniformRandom(&state));
+        read = before + (after - before) * uniformRandom(&state);
+        frame = (UInt64)((read - start) / nanosecondsPerFrame);
+        time = (UInt64)before + (UInt64)(after - before) / 2;
+
+        // A late interrupt covers the periods it skipped.
+        if (late > scenario.periodFrames * nanosecondsPerFrame)
+            period = frame / scenario.periodFrames;
+
+        // Answer a query somewhere in the period that follows.
+        if (time > lockTime) {
+            double query = after + uniformRandom(&state) * scenario.periodFrames * nanosecondsPerFrame;
+            UInt64 predicted;
+
+            queries++;
+            if (clock.predict((UInt64)query, &predicted))
+                position.add((double)predicted - (query - start) / nanosecondsPerFrame);
+            else
+                fallbacks++;
+        }
+
+        // Same order as AMDMicrophoneEngine::updateClock().
+        clock.update(time, frame);
+        while (frame >= nextWrapFrame) {
+            double trueTime = start + nextWrapFrame * nanosecondsPerFrame;
+            UInt64 wrapTime = clock.timeAt(nextWrapFrame);
+
+            if (wrapTime <= lastWrapTime)
+                wrapTime = lastWrapTime + 1;
+            lastWrapTime = wrapTime;
+            if (time > lockTime) {
+                model.add((wrapTime - trueTime) / 1000.0);
+                interrupt.add((time - trueTime) / 1000.0);
+            }
+            nextWrapFrame += CLOCK_TEST_RING_FRAMES;
+        }
+    }
+
+    passed = model.count && model.worst < CLOCK_TEST_LIMIT_US && !clock.relocks;
+    printf("%6.0f %8.1f %6u %8.2f %8.2f %8.2f %10.1f %10.1f %8.2f %8.2f %6.2f%% %6llu  %s\n",
+        scenario.jitterMicroseconds, scenario.driftPPM, scenario.periodFrames, model.mean(), model.rms(), model.worst,
+        interrupt.rms(), interrupt.worst, position.rms(), position.worst,
+        queries ? 100.0 * fallbacks / queries : 0.0, (unsigned long long)clock.relocks, passed ? "ok" : "FAILED");
+
+    return passed;
+}
+
+static int testClockMatrix(const ClockScenario* single)
+{
+    static const double jitters[] = { 0, 20, 100, 500 };
+    static const double drifts[] = { 0, 100, -300, 1000 };
+    static const UInt32 periods[] = { CLOCK_TEST_PERIOD_FRAMES, 240 };
+    bool passed = true;
+
+    printf("%6s %8s %6s %8s %8s %8s %10s %10s %8s %8s %7s %6s\n", "jitter", "drift", "period", "mean", "rms",
+        "max", "irq rms", "irq max", "pos rms", "pos max", "miss", "relock");
+    printf("%6s %8s %6s %8s %8s %8s %10s %10s %8s %8s %7s\n", "us", "ppm", "frames", "us", "us", "us", "us",
+        "us", "frames", "frames", "");
+
+    if (single)
+        return !testClock(*single);
+
+    for (UInt32 period : periods) {
+        for (double jitter : jitters) {
+            for (double drift : drifts)
+                passed &= testClock({ jitter, drift, period, CLOCK_TEST_SECONDS });
+        }
+    }
+
+    return !passed;
+}
+
+// Channels differ in level and lag so that the mono mix is not a copy.
+static void fillGoldenSignal(SInt32* ring)
+{
+    UInt32 state = 1;
+
+    for (UInt32 frame = 0; frame < GOLDEN_FRAMES; frame++) {
+        UInt32 part = frame * 5 / GOLDEN_FRAMES;
+
+        for (UInt32 channel = 0; channel < GOLDEN_CHANNELS; channel++) {
+            double time = (double)(frame - 3 * channel) / SAMPLE_RATE;
+            double level = channel ? 0.7 : 1.0;
+            double tone = sin(2.0 * M_PI * 1000.0 * time);
+            SInt32* sample = &ring[frame * GOLDEN_CHANNELS + channel];
+
+            state = state * 1664525 + 1013904223;
+            if (part == 0)
+                *sample = 0;
+            else if (part == 1)
+                *sample = (SInt32)state >> 12;
+            else if (part == 2)
+                *sample = (SInt32)(level * (0.5 * tone + 0.1 * sin(2.0 * M_PI * 40.0 * time)) * 2147483647.0)
+                    + ((SInt32)state >> 14);
+            else if (part == 3)
+                *sample = tone > 0.5 ? FIXED_Q31_MAX : tone < -0.5 ? FIXED_Q31_MIN : (SInt32)(2.0 * tone * 2147483647.0);
+            else
+                *sample = frame / 240 % 2 ? (SInt32)(level * (SInt32)state) : 0;
+        }
+    }
+}
+
+static void putLE(UInt8* bytes, UInt32 value, UInt32 size)
+{
+    for (UInt32 index = 0; index < size; index++)
+        bytes[index] = (UInt8)(value >> (8 * index));
+}
+
+static int writeGoldenInput(const char* path)
+{
+    static SInt32 ring[GOLDEN_FRAMES * GOLDEN_CHANNELS];
+    UInt32 dataBytes = sizeof(ring);
+    UInt8 header[44];
+    FILE* file;
+    bool written;
+
+    fillGoldenSignal(ring);
+    for (UInt32 index = 0; index < GOLDEN_FRAMES * GOLDEN_CHANNELS; index++)
+        putLE((UInt8*)&ring[index], (UInt32)ring[index], 4);
+
+    memcpy(header, "RIFF", 4);
+    putLE(header + 4, 36 + dataBytes, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLE(header + 16, 16, 4);
+    putLE(header + 20, 1, 2);
+    putLE(header + 22, GOLDEN_CHANNELS, 2);
+    putLE(header + 24, SAMPLE_RATE, 4);
+    putLE(header + 28, SAMPLE_RATE * GOLDEN_CHANNELS * 4, 4);
+    putLE(header + 32, GOLDEN_CHANNELS * 4, 2);
+    putLE(header + 34, 32, 2);
+    memcpy(header + 36, "data", 4);
+    putLE(header + 40, dataBytes, 4);
+
+    file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    written = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(ring, dataBytes, 1, file) == 1;
+    if (fclose(file) || !written) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    printf("%u frames written to %s\n", GOLDEN_FRAMES, path);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    UInt32 readers = TAP_TEST_READERS;
+    UInt64 frames = TAP_TEST_FRAMES;
+    int option;
+
+    if (argc == 2 && !strcmp(argv[1], "fixed"))
+        return testFixed();
+
+    if (argc == 3 && !strcmp(argv[1], "input"))
+        return writeGoldenInput(argv[2]);
+
+    if (argc >= 2 && !strcmp(argv[1], "tap")) {
+        optind = 2;
+        while ((option = getopt(argc, argv, "r:f:")) != -1) {
+            switch (option) {
+            case 'r':
+                readers = (UInt32)strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                return 2;
+            }
+        }
+        return testTap(readers, frames);
+    }
+
+    if (argc >= 2 && !strcmp(argv[1], "clock")) {
+        ClockScenario scenario = { 0, 0, CLOCK_TEST_PERIOD_FRAMES, CLOCK_TEST_SECONDS };
+        bool single = false;
+
+        optind = 2;
+        while ((option = getopt(argc, argv, "j:d:p:s:")) != -1) {
+            switch (option) {
+            case 'j':
+                scenario.jitterMicroseconds = strtod(optarg, NULL);
+                break;
+            case 'd':
+                scenario.driftPPM = strtod(optarg, NULL);
+                break;
+            case 'p':
+                scenario.periodFrames = (UInt32)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                scenario.seconds = (UInt32)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                return 2;
+            }
+            single = true;
+        }
+        if (!scenario.periodFrames || scenario.seconds <= CLOCK_TEST_LOCK_SECONDS)
+            return 2;
+        return testClockMatrix(single ? &scenario : NULL);
+    }
+
+    fprintf(
+        stderr,
+        "usage: %s fixed | tap [-r readers] [-f frames] | clock [-j us] [-d ppm] [-p frames] [-s seconds]\n"
+        "       %s input file.wav\n",
+        argv[0], argv[0]
+    );
+    return 2;
+}
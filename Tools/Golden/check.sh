@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+#  check.sh
+#  AMDMicrophone
+#
+#  Created by Huy Duong on 17/10/2026.
+#
+
+# Runs input.wav through process in every client format the engine
+# publishes and compares each output bit for bit with its golden file. The
+# fixed-point pipeline only runs at 48 kHz, so its golden files, prefixed
+# fixed-, cover the 48 kHz formats. After a deliberate change to the
+# processing, -u rewrites the golden files instead; review the change by
+# listening to them before committing.
+#
+#   Tools/Golden/check.sh [-u]
+
+set -e
+
+golden=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+c++ -std=c++17 -O2 -msse2 -I "$golden/../../AMDMicrophone" "$golden/../AMDMicrophoneProcess.cpp" -o "$work/process"
+
+failed=0
+update=$([ "$1" = -u ] && echo 1 || echo 0)
+
+# Runs process with the given options against the golden file name.
+check() {
+    name=$1
+    shift
+
+    if [ "$update" = 1 ]; then
+        "$work/process" "$@" "$golden/input.wav" "$golden/$name" 2>/dev/null
+        echo "wrote $name"
+    elif ! "$work/process" "$@" -g "$golden/$name" "$golden/input.wav" 2>/dev/null; then
+        echo "$name differs"
+        failed=1
+    fi
+}
+
+for rate in 16000 44100 48000 96000; do
+    for channels in mono stereo; do
+        for format in float 16-bit; do
+            options="-m $([ $channels = mono ] && echo 1 || echo 2) -b $([ $format = float ] && echo 32 || echo 16) -r $rate"
+
+            check $channels-$format-$rate.wav $options
+            if [ $rate = 48000 ]; then
+                check fixed-$channels-$format-$rate.wav $options -x
+            fi
+        done
+    done
+done
+
+exit $failed